@@ -1,4 +1,5 @@
 glslc ../resources/shaders/source/textured-shader.vert -o ../resources/shaders/generated/textured-vert.spv
+glslc ../resources/shaders/source/textured-shader-compact.vert -o ../resources/shaders/generated/textured-compact-vert.spv
 glslc ../resources/shaders/source/textured-shader.frag -o ../resources/shaders/generated/textured-frag.spv
 glslc ../resources/shaders/source/untextured-shader.vert -o ../resources/shaders/generated/untextured-vert.spv
 glslc ../resources/shaders/source/untextured-shader.frag -o ../resources/shaders/generated/untextured-frag.spv
@@ -3,7 +3,7 @@
 
 layout(location = 0) in vec2 fragTexCoord;
 
-layout(binding = 0) uniform sampler2D texSampler;
+layout(set = 1, binding = 0) uniform sampler2D texSampler;
 
 layout(location = 0) out vec4 outColor;
 
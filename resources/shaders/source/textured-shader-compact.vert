@@ -0,0 +1,53 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform SharedUniformBufferObject {
+    mat4 view;
+    mat4 proj;
+    vec4 lightPos;
+} sharedUbo;
+
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+// scale and offset map the unorm16 position back to model space. w is (0, 1) so the result has w = 1.
+layout(push_constant) uniform DrawPushConstants {
+    uint objectId;
+    vec4 scale;
+    vec4 offset;
+} push;
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inTexColor;
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec2 outTexColor;
+layout(location = 2) out vec3 outWorldPos;
+layout(location = 3) out vec3 outLightPos;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+
+void main() {
+    ObjectData object = objectBuffer.objects[push.objectId];
+    vec3 position = (inPosition * push.scale + push.offset).xyz;
+    vec4 worldPos = vec4(mat3(object.model) * position, 1.0);
+    gl_Position = sharedUbo.proj * sharedUbo.view * worldPos;
+    outNormal = mat3(object.normalMatrix) * decodeOctahedral(inNormal);
+    outLightPos = sharedUbo.lightPos.xyz;
+    outTexColor = inTexColor;
+    outWorldPos = worldPos.xyz;
+}
@@ -6,7 +6,7 @@ layout(location = 1) in vec2 fragTexCoord;
 layout(location = 2) in vec3 worldPos;
 layout(location = 3) in vec3 lightPos;
 
-layout(binding = 2) uniform sampler2D texSampler;
+layout(set = 1, binding = 0) uniform sampler2D texSampler;
 
 layout(location = 0) out vec4 outColor;
 
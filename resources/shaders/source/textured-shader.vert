@@ -1,16 +1,25 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-} ubo;
-
-layout(binding = 1) uniform SharedUniformBufferObject {
+layout(set = 0, binding = 0) uniform SharedUniformBufferObject {
     mat4 view;
     mat4 proj;
     vec4 lightPos;
 } sharedUbo;
 
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+layout(push_constant) uniform DrawPushConstants {
+    uint objectId;
+} push;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexColor;
@@ -21,9 +30,10 @@ layout(location = 2) out vec3 outWorldPos;
 layout(location = 3) out vec3 outLightPos;
 
 void main() {
-    vec4 worldPos = vec4(mat3(ubo.model) * inPosition, 1.0);
+    ObjectData object = objectBuffer.objects[push.objectId];
+    vec4 worldPos = vec4(mat3(object.model) * inPosition, 1.0);
     gl_Position = sharedUbo.proj * sharedUbo.view * worldPos;
-    outNormal = mat3(transpose(inverse(ubo.model))) * inNormal;
+    outNormal = mat3(object.normalMatrix) * inNormal;
     outLightPos = sharedUbo.lightPos.xyz;
     outTexColor = inTexColor;
     outWorldPos = worldPos.xyz;
@@ -1,7 +1,7 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 0) uniform SharedUniformBufferObject {
+layout(set = 0, binding = 0) uniform SharedUniformBufferObject {
     mat4 view;
     mat4 proj;
     vec4 lightPos;
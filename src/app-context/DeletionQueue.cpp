@@ -0,0 +1,47 @@
+#include "./DeletionQueue.h"
+
+DeletionQueue::DeletionQueue() : m_pending(1), m_currentFrame(0)
+{
+}
+
+DeletionQueue::~DeletionQueue()
+{
+    // Objects released after the frame loop (scene teardown, function-local statics) end up here.
+    flushAll();
+}
+
+void DeletionQueue::push(std::function<void()> &&deleter)
+{
+    m_pending[m_currentFrame].push_back(std::move(deleter));
+}
+
+void DeletionQueue::beginFrame(size_t frameIndex)
+{
+    if (frameIndex >= m_pending.size())
+    {
+        m_pending.resize(frameIndex + 1);
+    }
+
+    flush(frameIndex);
+    m_currentFrame = frameIndex;
+}
+
+void DeletionQueue::flushAll()
+{
+    for (size_t i = 0; i < m_pending.size(); i++)
+    {
+        flush(i);
+    }
+}
+
+void DeletionQueue::flush(size_t frameIndex)
+{
+    // Swap the list out first so a deleter that releases further objects cannot invalidate it.
+    std::vector<std::function<void()> > deleters;
+    deleters.swap(m_pending[frameIndex]);
+
+    for (auto &deleter : deleters)
+    {
+        deleter();
+    }
+}
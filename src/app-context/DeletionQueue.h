@@ -0,0 +1,35 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+// Holds back the destruction of Vulkan objects until the GPU can no longer be using them.
+// Deleters pushed while a frame slot is current run the next time that slot's in-flight
+// fence has been waited on, which covers every submission made up to and including that frame.
+class DeletionQueue
+{
+public:
+    DeletionQueue();
+    ~DeletionQueue();
+
+    void push(std::function<void()> &&deleter);
+
+    // Call right after waiting on the in-flight fence of frameIndex. Runs the deleters queued
+    // the last time that slot was current and makes it the slot new deleters go to.
+    void beginFrame(size_t frameIndex);
+
+    // Runs every pending deleter. The device must be idle.
+    void flushAll();
+
+private:
+    void flush(size_t frameIndex);
+
+private:
+    std::vector<std::vector<std::function<void()> > > m_pending;
+    size_t m_currentFrame;
+};
+
+namespace VulkanGlobal
+{
+    extern DeletionQueue deletionQueue;
+}
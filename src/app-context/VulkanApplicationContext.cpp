@@ -1,8 +1,11 @@
 #include "../utils/vulkan.h"
 #include <iostream>
+#include <cstring>
 #define VMA_IMPLEMENTATION
 #include "vk_mem_alloc.h"
 #include "VulkanApplicationContext.h"
+#include "../memory/MemoryStats.h"
+#include "../render-context/PipelineCache.h"
 
 VulkanApplicationContext::VulkanApplicationContext()
 {
@@ -12,13 +15,22 @@ VulkanApplicationContext::VulkanApplicationContext()
     createDevice();
 
     createCommandPool();
+    createPipelineCache();
 }
 
 VulkanApplicationContext::~VulkanApplicationContext()
 {
     std::cout << "Destroying context"
               << "\n";
+    if (hasDedicatedTransferQueue())
+    {
+        vkDestroyCommandPool(m_vkbDevice.device, m_transferCommandPool, nullptr);
+    }
     vkDestroyCommandPool(m_vkbDevice.device, m_commandPool, nullptr);
+    mcvkp::PipelineCache::printStats(std::cout);
+    mcvkp::PipelineCache::save(m_vkbDevice.device, m_vkbDevice.physical_device, m_pipelineCache, mcvkp::PipelineCache::DEFAULT_PATH);
+    vkDestroyPipelineCache(m_vkbDevice.device, m_pipelineCache, nullptr);
+    mcvkp::MemoryStats::reportLeaks(std::cout);
     vmaDestroyAllocator(m_allocator);
     vkDestroySurfaceKHR(m_vkbInstance.instance, m_surface, nullptr);
 
@@ -65,12 +77,49 @@ void VulkanApplicationContext::createDevice()
     vkb::PhysicalDeviceSelector phys_device_selector(m_vkbInstance);
     auto phys_dev_ret = phys_device_selector
                             .add_desired_extension("VK_KHR_portability_subset")
+                            .add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+                            .add_desired_extension(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME)
                             .set_surface(m_surface)
                             .select();
     if (!phys_dev_ret)
     {
         throw std::runtime_error("Failed to create physical device. Error: " + phys_dev_ret.error().message());
     }
+
+    // Drawing several meshlet ranges with one indirect draw needs multiDrawIndirect. Enable it where supported.
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(phys_dev_ret.value().physical_device, &supportedFeatures);
+    m_maxDrawIndirectCount = 1;
+    if (supportedFeatures.multiDrawIndirect == VK_TRUE)
+    {
+        VkPhysicalDeviceFeatures requiredFeatures{};
+        requiredFeatures.multiDrawIndirect = VK_TRUE;
+        phys_dev_ret = phys_device_selector.set_required_features(requiredFeatures).select();
+        if (!phys_dev_ret)
+        {
+            throw std::runtime_error("Failed to create physical device. Error: " + phys_dev_ret.error().message());
+        }
+        m_maxDrawIndirectCount = phys_dev_ret.value().properties.limits.maxDrawIndirectCount;
+    }
+    // Desired extensions are enabled when present, so this tells which of them are on.
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(phys_dev_ret.value().physical_device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(phys_dev_ret.value().physical_device, nullptr, &extensionCount, extensions.data());
+    m_hasMemoryBudget = false;
+    m_hasPipelineCreationFeedback = false;
+    for (const VkExtensionProperties &extension : extensions)
+    {
+        if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+        {
+            m_hasMemoryBudget = true;
+        }
+        if (strcmp(extension.extensionName, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) == 0)
+        {
+            m_hasPipelineCreationFeedback = true;
+        }
+    }
+
     //m_physicalDevice = phys_dev_ret.value();
     vkb::DeviceBuilder device_builder{phys_dev_ret.value()};
     auto dev_ret = device_builder.build();
@@ -85,6 +134,10 @@ void VulkanApplicationContext::createDevice()
     allocatorInfo.physicalDevice = phys_dev_ret.value();
     allocatorInfo.device = m_vkbDevice.device;
     allocatorInfo.instance = m_vkbInstance.instance;
+    if (m_hasMemoryBudget)
+    {
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
 
     if (vmaCreateAllocator(&allocatorInfo, &m_allocator) != VK_SUCCESS)
     {
@@ -108,14 +161,40 @@ void VulkanApplicationContext::createCommandPool()
     }
     m_presentQueue = p_queue_ret.value();
 
+    m_graphicsQueueFamily = m_vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
+
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.queueFamilyIndex = m_vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
+    poolInfo.queueFamilyIndex = m_graphicsQueueFamily;
     poolInfo.flags = 0; // Optional
     if (vkCreateCommandPool(m_vkbDevice.device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create command pool!");
     }
+
+    // vk-bootstrap only hands out a transfer queue from a family without graphics. Devices without
+    // one (lavapipe, for example) upload on the graphics queue.
+    auto t_queue_ret = m_vkbDevice.get_queue(vkb::QueueType::transfer);
+    if (!t_queue_ret)
+    {
+        m_transferQueue = m_graphicsQueue;
+        m_transferQueueFamily = m_graphicsQueueFamily;
+        m_transferCommandPool = m_commandPool;
+        return;
+    }
+    m_transferQueue = t_queue_ret.value();
+    m_transferQueueFamily = m_vkbDevice.get_queue_index(vkb::QueueType::transfer).value();
+
+    poolInfo.queueFamilyIndex = m_transferQueueFamily;
+    if (vkCreateCommandPool(m_vkbDevice.device, &poolInfo, nullptr, &m_transferCommandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create transfer command pool!");
+    }
+}
+
+void VulkanApplicationContext::createPipelineCache()
+{
+    m_pipelineCache = mcvkp::PipelineCache::create(m_vkbDevice.device, m_vkbDevice.physical_device, mcvkp::PipelineCache::DEFAULT_PATH);
 }
 
 VkFormat VulkanApplicationContext::findSupportedFormat(const std::vector<VkFormat> &candidates,
@@ -165,6 +244,31 @@ const VkCommandPool &VulkanApplicationContext::getCommandPool() const
     return m_commandPool;
 }
 
+const VkQueue &VulkanApplicationContext::getTransferQueue() const
+{
+    return m_transferQueue;
+}
+
+const VkCommandPool &VulkanApplicationContext::getTransferCommandPool() const
+{
+    return m_transferCommandPool;
+}
+
+uint32_t VulkanApplicationContext::getGraphicsQueueFamily() const
+{
+    return m_graphicsQueueFamily;
+}
+
+uint32_t VulkanApplicationContext::getTransferQueueFamily() const
+{
+    return m_transferQueueFamily;
+}
+
+bool VulkanApplicationContext::hasDedicatedTransferQueue() const
+{
+    return m_transferQueueFamily != m_graphicsQueueFamily;
+}
+
 const VmaAllocator &VulkanApplicationContext::getAllocator() const
 {
     return m_allocator;
@@ -175,7 +279,32 @@ const vkb::Device &VulkanApplicationContext::getVkbDevice() const
     return m_vkbDevice;
 }
 
+uint32_t VulkanApplicationContext::getMaxDrawIndirectCount() const
+{
+    return m_maxDrawIndirectCount;
+}
+
+VkDeviceSize VulkanApplicationContext::getMinUniformBufferOffsetAlignment() const
+{
+    return m_vkbDevice.physical_device.properties.limits.minUniformBufferOffsetAlignment;
+}
+
 GLFWwindow *VulkanApplicationContext::getWindow() const
 {
     return m_window;
 }
+
+bool VulkanApplicationContext::hasMemoryBudget() const
+{
+    return m_hasMemoryBudget;
+}
+
+const VkPipelineCache &VulkanApplicationContext::getPipelineCache() const
+{
+    return m_pipelineCache;
+}
+
+bool VulkanApplicationContext::hasPipelineCreationFeedback() const
+{
+    return m_hasPipelineCreationFeedback;
+}
@@ -30,10 +30,38 @@ class VulkanApplicationContext {
 
         const VkCommandPool& getCommandPool() const;
 
+        // A queue of a transfer-only family when the device has one, otherwise the graphics queue.
+        const VkQueue& getTransferQueue() const;
+
+        // Pool for the transfer queue's family. Same as getCommandPool() without a transfer family.
+        const VkCommandPool& getTransferCommandPool() const;
+
+        uint32_t getGraphicsQueueFamily() const;
+
+        uint32_t getTransferQueueFamily() const;
+
+        // Uploads then need queue family ownership transfers to the graphics queue.
+        bool hasDedicatedTransferQueue() const;
+
         const VmaAllocator& getAllocator() const;
 
         const vkb::Device& getVkbDevice() const;
 
+        // 1 unless multiDrawIndirect is enabled.
+        uint32_t getMaxDrawIndirectCount() const;
+
+        // Dynamic uniform buffer offsets must be multiples of this.
+        VkDeviceSize getMinUniformBufferOffsetAlignment() const;
+
+        // Whether VK_EXT_memory_budget is enabled. Without it VMA estimates heap budgets.
+        bool hasMemoryBudget() const;
+
+        // Shared by every pipeline. Loaded from and saved to PipelineCache::DEFAULT_PATH.
+        const VkPipelineCache& getPipelineCache() const;
+
+        // Whether VK_EXT_pipeline_creation_feedback is enabled, so cache hits can be told from misses.
+        bool hasPipelineCreationFeedback() const;
+
         GLFWwindow* getWindow() const;
 
     private:
@@ -47,6 +75,8 @@ class VulkanApplicationContext {
 
         void createCommandPool();
 
+        void createPipelineCache();
+
     private:
         GLFWwindow* m_window;
         vkb::Instance m_vkbInstance;
@@ -54,8 +84,16 @@ class VulkanApplicationContext {
         VkQueue m_graphicsQueue;
         VkQueue m_presentQueue;
         VkCommandPool m_commandPool;
+        VkQueue m_transferQueue;
+        VkCommandPool m_transferCommandPool;
+        uint32_t m_graphicsQueueFamily;
+        uint32_t m_transferQueueFamily;
         VmaAllocator m_allocator;
         vkb::Device m_vkbDevice;
+        uint32_t m_maxDrawIndirectCount;
+        bool m_hasMemoryBudget;
+        bool m_hasPipelineCreationFeedback;
+        VkPipelineCache m_pipelineCache;
 };
 
 namespace VulkanGlobal {
@@ -3,4 +3,7 @@ namespace VulkanGlobal {
     const VulkanApplicationContext context{};
 
     const VulkanSwapchain swapchainContext{};
+
+    // Declared after the context so it is destroyed, and flushed, while the device still exists.
+    DeletionQueue deletionQueue{};
 }
\ No newline at end of file
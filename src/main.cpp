@@ -4,23 +4,37 @@
 #include <vector>
 #include <array>
 #include <memory>
+#include <string>
+#include <algorithm>
 #include "utils/vulkan.h"
 #include "app-context/VulkanApplicationContext.h"
 #include "app-context/VulkanSwapchain.h"
+#include "app-context/DeletionQueue.h"
 #include "app-context/VulkanGlobal.h"
 #include "utils/RootDir.h"
 #include "memory/Buffer.h"
+#include "memory/UniformRingBuffer.h"
+#include "memory/GeometryArena.h"
+#include "memory/UploadBatch.h"
+#include "memory/MemoryStats.h"
+#include "memory/Defragmenter.h"
 #include "utils/glm.h"
 #include "utils/Camera.h"
 #include "scene/Mesh.h"
 #include "scene/Scene.h"
 #include "scene/DrawableModel.h"
+#include "scene/ObjectStore.h"
 #include "render-context/ForwardRenderPass.h"
 #include "render-context/FlatRenderPass.h"
 #include "render-context/RenderSystem.h"
+#include "render-context/RenderGraph.h"
+#include "render-context/ParallelCommandRecorder.h"
+#include "render-context/DescriptorAllocator.h"
+#include "render-context/DescriptorLayoutCache.h"
 #include <thread>
 
 #include "scene/Material.h"
+#include "scene/ResourceBindings.h"
 // TODO: Organize includes!
 
 #include <stdint.h>
@@ -37,7 +51,11 @@ float deltaTime = 0.0f; // Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 Camera camera(glm::vec3(3.0f, 1.0f, 0.0f));
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+// Frames the CPU may submit before waiting on the GPU. Set with --frames-in-flight.
+size_t maxFramesInFlight = 2;
+// Attachment sets of the forward pass, 0 for one per swapchain image. Set with --attachment-sets.
+// With 1 every frame renders into the same images and waits for the previous frame's post process.
+size_t attachmentSets = 0;
 
 /**
  *  This program renders 2 dogs and a light cube using vulkan API.
@@ -55,14 +73,26 @@ public:
 private:
     // A scene with two dogs and a light.
     std::shared_ptr<mcvkp::Scene> scene;
+    // Follows the light, so culling and LOD selection see where the shader draws it.
+    std::shared_ptr<mcvkp::DrawableModel> lightCubeModel;
     // A scene with a screen quad.
     std::shared_ptr<mcvkp::Scene> postProcessScene;
+    // Forward pass into transient images, then the post process pass into the swapchain.
+    std::shared_ptr<mcvkp::RenderGraph> renderGraph;
 
     // UBO shared by all objects. Contains view/projection matrices and a light position.
     SharedUniformBufferObject sharedUbo;
-    std::shared_ptr<mcvkp::BufferBundle> sharedUniformBufferBundle;
-
-    std::vector<VkCommandBuffer> commandBuffers;
+    // Persistently mapped per-frame uniform data, bound with dynamic offsets.
+    std::shared_ptr<mcvkp::UniformRingBuffer> uniformRing;
+    mcvkp::UniformRingBuffer::Allocation sharedUboAllocation;
+    std::shared_ptr<mcvkp::ObjectStore> objectStore;
+    // Descriptor set 0 of the forward scene's materials.
+    std::shared_ptr<mcvkp::ResourceBindings> frameGlobals;
+    // Compacts GPU memory over a few frames once enough of it is wasted.
+    std::unique_ptr<mcvkp::Defragmenter> defragmenter;
+
+    // Per-frame command pools; the forward pass is recorded on all cores every frame.
+    std::unique_ptr<mcvkp::ParallelCommandRecorder> commandRecorder;
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
     // Fences to keep track of the images currently in the graphics queue.
@@ -74,70 +104,125 @@ private:
     {
         using namespace mcvkp;
 
-        scene = std::make_shared<Scene>(RenderPassType::eForward);
+        size_t numAttachmentSets = attachmentSets == 0 ? VulkanGlobal::swapchainContext.getImageViews().size() : attachmentSets;
+        renderGraph = std::make_shared<RenderGraph>(numAttachmentSets);
+        VkFormat depthFormat = VulkanGlobal::context.findSupportedFormat(
+            {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        RenderGraph::ResourceHandle sceneColor = renderGraph->createImage("scene color", VulkanGlobal::swapchainContext.getFormat(), VK_IMAGE_ASPECT_COLOR_BIT);
+        RenderGraph::ResourceHandle sceneDepth = renderGraph->createImage("scene depth", depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+        RenderGraph::ResourceHandle backbuffer = renderGraph->importSwapchain();
+
+        RenderGraph::PassHandle forwardPass = renderGraph->addPass(
+            "forward", [this](VkCommandBuffer &commandBuffer, size_t index)
+            { scene->recordDraws(commandBuffer, index, *commandRecorder); },
+            VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        renderGraph->writeColor(forwardPass, sceneColor, {1.0f, 0.5f, 1.0f, 1.0f});
+        renderGraph->writeDepth(forwardPass, sceneDepth, 1.0f);
+
+        RenderGraph::PassHandle postProcessPass = renderGraph->addPass("post process", [this](VkCommandBuffer &commandBuffer, size_t index)
+                                                                       { postProcessScene->recordDraws(commandBuffer, index); });
+        renderGraph->readTexture(postProcessPass, sceneColor);
+        renderGraph->writeColor(postProcessPass, backbuffer, {1.0f, 0.5f, 1.0f, 1.0f});
+        renderGraph->compile();
+
+        scene = std::make_shared<Scene>(renderGraph->getRenderPass(forwardPass));
+        std::cout << numAttachmentSets << " forward attachment sets, " << maxFramesInFlight << " frames in flight\n";
 
         /**
          * Creating buffers.
          */
         uint32_t descriptorSetsSize = VulkanGlobal::swapchainContext.getImageViews().size();
-        std::shared_ptr<BufferBundle> dogeBufferBundle = std::make_shared<mcvkp::BufferBundle>(descriptorSetsSize);
-        std::shared_ptr<BufferBundle> cheemzBufferBundle = std::make_shared<mcvkp::BufferBundle>(descriptorSetsSize);
-
-        // BufferBundle is a wrapper for a collection of buffers. Used to symultaniously update and render when several frames are in flight.
-        BufferUtils::createBundle<UniformBufferObject>(dogeBufferBundle.get(), UniformBufferObject(glm::mat4(2.0f)),
-                                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
 
-        BufferUtils::createBundle<UniformBufferObject>(cheemzBufferBundle.get(), UniformBufferObject(glm::mat4(1.0f)),
-                                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        // Transforms of all objects, one storage buffer per frame indexed by each model's object id.
+        objectStore = std::make_shared<ObjectStore>(descriptorSetsSize);
+        glm::mat4 dogeModelMatrix(2.0f);
+        glm::mat4 cheemzModelMatrix(1.0f);
+        uint32_t dogeObjectId = objectStore->add(dogeModelMatrix);
+        uint32_t cheemzObjectId = objectStore->add(cheemzModelMatrix);
 
-        sharedUniformBufferBundle = std::make_shared<mcvkp::BufferBundle>(descriptorSetsSize);
+        uniformRing = std::make_shared<UniformRingBuffer>(descriptorSetsSize);
+        sharedUboAllocation = uniformRing->allocateInitialized(sharedUbo);
 
-        BufferUtils::createBundle<SharedUniformBufferObject>(sharedUniformBufferBundle.get(), sharedUbo, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                             VMA_MEMORY_USAGE_CPU_TO_GPU);
+        // Camera and transforms change every frame but are the same for every material.
+        frameGlobals = std::make_shared<ResourceBindings>();
+        frameGlobals->addDynamicUniform(uniformRing, sharedUboAllocation, VK_SHADER_STAGE_VERTEX_BIT);
+        frameGlobals->addStorageBufferBundle(objectStore->getBufferBundle(), VK_SHADER_STAGE_VERTEX_BIT);
 
         /**
          * Creating textures and materials.
          */
-        std::shared_ptr<Texture> dogeTex = std::make_shared<Texture>(path_prefix + "/textures/Doge");
-        std::shared_ptr<Texture> cheemzTex = std::make_shared<Texture>(path_prefix + "/textures/Cheems");
+        // Every texture and mesh upload goes into one command buffer, submitted once at the end.
+        UploadBatch uploadBatch;
+        std::shared_ptr<Texture> dogeTex = std::make_shared<Texture>(path_prefix + "/textures/Doge", uploadBatch);
+        std::shared_ptr<Texture> cheemzTex = std::make_shared<Texture>(path_prefix + "/textures/Cheems", uploadBatch);
 
         std::shared_ptr<Material> dogeMaterial = std::make_shared<Material>(
-            path_prefix + "/shaders/generated/textured-vert.spv",
-            path_prefix + "/shaders/generated/textured-frag.spv");
-        dogeMaterial->addBufferBundle(dogeBufferBundle, VK_SHADER_STAGE_VERTEX_BIT);
-        dogeMaterial->addBufferBundle(sharedUniformBufferBundle, VK_SHADER_STAGE_VERTEX_BIT);
+            path_prefix + "/shaders/generated/textured-compact-vert.spv",
+            path_prefix + "/shaders/generated/textured-frag.spv",
+            VertexFormat::eCompact);
+        dogeMaterial->setGlobals(frameGlobals);
         dogeMaterial->addTexture(dogeTex, VK_SHADER_STAGE_FRAGMENT_BIT);
 
         std::shared_ptr<Material> cheemzMaterial = std::make_shared<Material>(
-            path_prefix + "/shaders/generated/textured-vert.spv",
-            path_prefix + "/shaders/generated/textured-frag.spv");
-        cheemzMaterial->addBufferBundle(cheemzBufferBundle, VK_SHADER_STAGE_VERTEX_BIT);
-        cheemzMaterial->addBufferBundle(sharedUniformBufferBundle, VK_SHADER_STAGE_VERTEX_BIT);
+            path_prefix + "/shaders/generated/textured-compact-vert.spv",
+            path_prefix + "/shaders/generated/textured-frag.spv",
+            VertexFormat::eCompact);
+        cheemzMaterial->setGlobals(frameGlobals);
         cheemzMaterial->addTexture(cheemzTex, VK_SHADER_STAGE_FRAGMENT_BIT);
 
         std::shared_ptr<Material> lightCubeMaterial = std::make_shared<Material>(
             path_prefix + "/shaders/generated/untextured-vert.spv",
             path_prefix + "/shaders/generated/untextured-frag.spv");
-        lightCubeMaterial->addBufferBundle(sharedUniformBufferBundle, VK_SHADER_STAGE_VERTEX_BIT);
+        lightCubeMaterial->setGlobals(frameGlobals);
 
         /**
          * Adding models to scene.
          */
-        scene->addModel(std::make_shared<DrawableModel>(dogeMaterial, path_prefix + "/models/buffDoge.obj"));
-        scene->addModel(std::make_shared<DrawableModel>(cheemzMaterial, path_prefix + "/models/cheems.obj"));
-        scene->addModel(std::make_shared<DrawableModel>(lightCubeMaterial, path_prefix + "/models/cube.obj"));
+        MeshImportOptions importOptions;
+        importOptions.optimize = true;
+        importOptions.buildMeshlets = true;
+        importOptions.buildLods = true;
+        MeshImportOptions compactImportOptions = importOptions;
+        compactImportOptions.vertexFormat = VertexFormat::eCompact;
+        std::shared_ptr<DrawableModel> dogeModel = std::make_shared<DrawableModel>(dogeMaterial, path_prefix + "/models/buffDoge.obj", compactImportOptions, &uploadBatch);
+        dogeModel->setModelMatrix(dogeModelMatrix);
+        dogeModel->setObjectId(dogeObjectId);
+        std::shared_ptr<DrawableModel> cheemzModel = std::make_shared<DrawableModel>(cheemzMaterial, path_prefix + "/models/cheems.obj", compactImportOptions, &uploadBatch);
+        cheemzModel->setModelMatrix(cheemzModelMatrix);
+        cheemzModel->setObjectId(cheemzObjectId);
+        scene->addModel(dogeModel);
+        scene->addModel(cheemzModel);
+        lightCubeModel = std::make_shared<DrawableModel>(lightCubeMaterial, path_prefix + "/models/cube.obj", importOptions, &uploadBatch);
+        scene->addModel(lightCubeModel);
 
         /**
          * Creating flat scene for post process.
          */
-        postProcessScene = std::make_shared<Scene>(RenderPassType::eFlat);
+        postProcessScene = std::make_shared<Scene>(renderGraph->getRenderPass(postProcessPass));
 
-        std::shared_ptr<Texture> screenTex = std::make_shared<Texture>(scene->getRenderPass()->getColorImage());
+        // Descriptor set i samples the color image that command buffer i rendered into.
+        std::vector<std::shared_ptr<Texture> > screenTextures;
+        for (size_t i = 0; i < numAttachmentSets; i++)
+        {
+            screenTextures.push_back(std::make_shared<Texture>(renderGraph->getImage(sceneColor, i)));
+        }
         std::shared_ptr<Material> screenMaterial = std::make_shared<Material>(
             path_prefix + "/shaders/generated/post-process-vert.spv",
             path_prefix + "/shaders/generated/post-process-frag.spv");
-        screenMaterial->addTexture(screenTex, VK_SHADER_STAGE_FRAGMENT_BIT);
-        postProcessScene->addModel(std::make_shared<DrawableModel>(screenMaterial, MeshType::ePlane));
+        screenMaterial->addTexture(screenTextures, VK_SHADER_STAGE_FRAGMENT_BIT);
+        postProcessScene->addModel(std::make_shared<DrawableModel>(screenMaterial, MeshType::ePlane, &uploadBatch));
+
+        // Every pipeline was submitted above and compiles in parallel; the first frame needs them all.
+        auto pipelineWaitStart = std::chrono::high_resolution_clock::now();
+        scene->waitForPipelines();
+        postProcessScene->waitForPipelines();
+        std::cout << "Waited " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelineWaitStart).count()
+                  << " ms for pipelines after scene setup\n";
+        uploadBatch.wait();
+        std::cout << "Uploaded " << uploadBatch.getBytesStaged() / 1024 << " KiB of textures and geometry in one submission on the "
+                  << (VulkanGlobal::context.hasDedicatedTransferQueue() ? "dedicated transfer" : "graphics") << " queue\n";
     }
 
     void updateScene(uint32_t currentImage)
@@ -148,38 +233,33 @@ private:
         float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
         sharedUbo.view = camera.GetViewMatrix();
-        sharedUbo.proj = glm::perspective(glm::radians(45.0f), WIDTH / (float)HEIGHT, 0.1f, 10.0f);
+        float fovy = glm::radians(45.0f);
+        sharedUbo.proj = glm::perspective(fovy, WIDTH / (float)HEIGHT, 0.1f, 10.0f);
         sharedUbo.proj[1][1] *= -1;
         sharedUbo.lightPos = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f)) * glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
-        VkDeviceSize bufferSize = sizeof(sharedUbo);
+        lightCubeModel->setModelMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(sharedUbo.lightPos)));
+        float projectionScale = VulkanGlobal::swapchainContext.getExtent().height / (2.0f * std::tan(fovy * 0.5f));
+        scene->updateDrawCommands(sharedUbo.proj * sharedUbo.view, camera.Position, projectionScale, currentImage);
 
-        void *data;
-        vmaMapMemory(VulkanGlobal::context.getAllocator(), sharedUniformBufferBundle->buffers[currentImage]->allocation, &data);
-        memcpy(data, &sharedUbo, bufferSize);
-        vmaUnmapMemory(VulkanGlobal::context.getAllocator(), sharedUniformBufferBundle->buffers[currentImage]->allocation);
+        *uniformRing->get<SharedUniformBufferObject>(sharedUboAllocation, currentImage) = sharedUbo;
+        uniformRing->flush(currentImage);
     }
 
-    void createCommandBuffers()
+    // Recorded every frame, after the culling results and uniforms of the image are updated.
+    // Pools are per frame in flight: the frame's fence has signaled, so its previous buffers are done.
+    VkCommandBuffer recordCommandBuffer(uint32_t imageIndex)
     {
-        mcvkp::RenderSystem::allocateCommandBuffers(commandBuffers, VulkanGlobal::swapchainContext.getImageViews().size());
-
-        for (size_t i = 0; i < commandBuffers.size(); i++)
-        {
-            mcvkp::RenderSystem::beginCommandBuffer(commandBuffers[i]);
-
-            scene->writeRenderCommand(commandBuffers[i], i);
-
-            postProcessScene->writeRenderCommand(commandBuffers[i], i);
-
-            mcvkp::RenderSystem::endCommandBuffer(commandBuffers[i]);
-        }
+        VkCommandBuffer commandBuffer = commandRecorder->beginFrame(currentFrame);
+        renderGraph->execute(commandBuffer, imageIndex);
+        mcvkp::RenderSystem::endCommandBuffer(commandBuffer);
+        return commandBuffer;
     }
 
     void createSyncObjects()
     {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        imageAvailableSemaphores.resize(maxFramesInFlight);
+        renderFinishedSemaphores.resize(maxFramesInFlight);
+        inFlightFences.resize(maxFramesInFlight);
         imagesInFlight.resize(VulkanGlobal::swapchainContext.getImageViews().size());
 
         VkSemaphoreCreateInfo semaphoreInfo{};
@@ -189,7 +269,7 @@ private:
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        for (size_t i = 0; i < maxFramesInFlight; i++)
         {
             if (vkCreateSemaphore(VulkanGlobal::context.getDevice(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
                 vkCreateSemaphore(VulkanGlobal::context.getDevice(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
@@ -202,9 +282,13 @@ private:
     }
 
     size_t currentFrame = 0;
+    uint32_t frameNumber = 0;
     void drawFrame()
     {
         vkWaitForFences(VulkanGlobal::context.getDevice(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        VulkanGlobal::deletionQueue.beginFrame(currentFrame);
+        mcvkp::MemoryStats::setFrameIndex(frameNumber++);
+        defragmenter->update();
 
         uint32_t imageIndex;
         VkResult result = vkAcquireNextImageKHR(VulkanGlobal::context.getDevice(), VulkanGlobal::swapchainContext.getBody(), UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
@@ -227,25 +311,27 @@ private:
         imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
         updateScene(imageIndex);
+        VkCommandBuffer commandBuffer = recordCommandBuffer(imageIndex);
 
         vkResetFences(VulkanGlobal::context.getDevice(), 1, &inFlightFences[currentFrame]);
 
         VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
         VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        mcvkp::RenderSystem::submit(&commandBuffers[imageIndex], 1, waitSemaphores, waitStages, signalSemaphores, inFlightFences[currentFrame]);
+        mcvkp::RenderSystem::submit(&commandBuffer, 1, waitSemaphores, waitStages, signalSemaphores, inFlightFences[currentFrame]);
 
         mcvkp::RenderSystem::present(imageIndex, signalSemaphores, 1);
 
         // Commented this out for playing around with it later :)
         // vkQueueWaitIdle(VulkanGlobal::context.getPresentQueue());
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrame = (currentFrame + 1) % maxFramesInFlight;
     }
 
     int nbFrames = 0;
     float lastTime = 0;
     void mainLoop()
     {
+        float startTime = (float)glfwGetTime();
         while (!glfwWindowShouldClose(VulkanGlobal::context.getWindow()))
         {
             float currentTime = (float)glfwGetTime();
@@ -254,7 +340,14 @@ private:
             if (currentTime - lastTime >= 1.0)
             { // If last prinf() was more than 1 sec ago
                 // printf and reset timer
-                printf("%f ms/frame\n", 1000.0 / double(nbFrames));
+                size_t visibleTriangles, totalTriangles;
+                scene->getTriangleCounts(visibleTriangles, totalTriangles);
+                printf("%f ms/frame, %zu/%zu triangles drawn/full detail\n", 1000.0 / double(nbFrames), visibleTriangles, totalTriangles);
+                mcvkp::MemoryStats::printReport(std::cout);
+                if (!defragmenter->isRunning() && defragmenter->isWorthRunning())
+                {
+                    defragmenter->start();
+                }
                 nbFrames = 0;
                 lastTime = currentTime;
             }
@@ -266,34 +359,76 @@ private:
         }
 
         vkDeviceWaitIdle(VulkanGlobal::context.getDevice());
+        // Compare runs with different --frames-in-flight and --attachment-sets values.
+        if (frameNumber > 0)
+        {
+            printf("%u frames, %f ms/frame on average\n", frameNumber, 1000.0 * ((float)glfwGetTime() - startTime) / double(frameNumber));
+        }
     }
 
     void initVulkan()
     {
         initScene();
-
-        createCommandBuffers();
+        std::cout << "Staged " << mcvkp::BufferUtils::getBytesStaged() / 1024 << " KiB of scene data to device-local memory\n";
+        std::cout << mcvkp::PipelineTemplate::getLiveCount() << " pipeline templates shared by the scene's materials\n";
+        std::cout << mcvkp::DescriptorAllocator::shared()->getLiveSetCount() << " descriptor sets in "
+                  << mcvkp::DescriptorAllocator::shared()->getPoolCount() << " descriptor pools, "
+                  << mcvkp::DescriptorLayoutCache::shared()->getLayoutCount() << " distinct set layouts\n";
+        std::cout << "Geometry arena: " << mcvkp::GeometryArena::get().getBytesAllocated() / 1024 << " of "
+                  << mcvkp::GeometryArena::get().getBytesReserved() / 1024 << " KiB in use\n";
+        std::cout << "Heap budgets " << (VulkanGlobal::context.hasMemoryBudget() ? "from VK_EXT_memory_budget" : "estimated by VMA") << "\n";
+
+        commandRecorder = std::make_unique<mcvkp::ParallelCommandRecorder>(maxFramesInFlight);
+        std::cout << "Recording draws on up to " << commandRecorder->getWorkerCount() << " threads\n";
         createSyncObjects();
+
+        // Moved resources have new handles, so descriptor sets are rebuilt. Command buffers pick them up on the next recording.
+        defragmenter = std::make_unique<mcvkp::Defragmenter>([this]()
+                                                            {
+                                                                frameGlobals->updateDescriptorSets();
+                                                                scene->updateDescriptorSets();
+                                                                postProcessScene->updateDescriptorSets(); });
         glfwSetCursorPosCallback(VulkanGlobal::context.getWindow(), mouse_callback);
     }
 
     void cleanup()
     {
-        vkFreeCommandBuffers(VulkanGlobal::context.getDevice(), VulkanGlobal::context.getCommandPool(), static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        defragmenter.reset();
+        commandRecorder.reset();
+        // Models hand their geometry back through the deletion queue, which must run while the arena still exists.
+        scene.reset();
+        lightCubeModel.reset();
+        postProcessScene.reset();
+
+        for (size_t i = 0; i < maxFramesInFlight; i++)
         {
             vkDestroySemaphore(VulkanGlobal::context.getDevice(), renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(VulkanGlobal::context.getDevice(), imageAvailableSemaphores[i], nullptr);
             vkDestroyFence(VulkanGlobal::context.getDevice(), inFlightFences[i], nullptr);
         }
 
+        mcvkp::BufferUtils::destroyStagingPool();
+        VulkanGlobal::deletionQueue.flushAll();
         glfwTerminate();
     }
 };
 
-int main()
+int main(int argc, char **argv)
 {
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t *option = arg == "--frames-in-flight" ? &maxFramesInFlight : arg == "--attachment-sets" ? &attachmentSets
+                                                                                                          : nullptr;
+        if (option == nullptr || i + 1 == argc)
+        {
+            std::cerr << "usage: " << argv[0] << " [--frames-in-flight N] [--attachment-sets N]\n";
+            return EXIT_FAILURE;
+        }
+        *option = std::strtoul(argv[++i], nullptr, 10);
+    }
+    maxFramesInFlight = std::max<size_t>(maxFramesInFlight, 1);
+
     HelloDogApplication app;
 
     try
@@ -322,6 +457,18 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    // Dump VMA's detailed statistics once per key press.
+    static bool statsKeyDown = false;
+    bool statsKeyPressed = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+    if (statsKeyPressed && !statsKeyDown)
+    {
+        if (mcvkp::MemoryStats::writeDetailedStatsJson("memory-stats.json"))
+            std::cout << "Wrote memory-stats.json\n";
+        else
+            std::cout << "Failed to write memory-stats.json\n";
+    }
+    statsKeyDown = statsKeyPressed;
 }
 
 float lastX = 400, lastY = 300;
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include "Buffer.h"
+#include "UploadBatch.h"
+
+namespace mcvkp
+{
+    namespace BufferUtils
+    {
+        namespace
+        {
+            // Staging buffers are rounded up to a power of two no smaller than this, so they can be reused.
+            const VkDeviceSize MIN_STAGING_SIZE = 1 << 16;
+
+            struct StagingPool
+            {
+                std::vector<std::shared_ptr<Buffer> > freeBuffers;
+                VkDeviceSize bytesStaged = 0;
+            };
+
+            StagingPool &stagingPool()
+            {
+                static StagingPool pool;
+                return pool;
+            }
+        }
+
+        std::shared_ptr<Buffer> acquireStagingBuffer(VkDeviceSize size)
+        {
+            StagingPool &pool = stagingPool();
+            pool.bytesStaged += size;
+
+            // Smallest free buffer that fits.
+            auto best = pool.freeBuffers.end();
+            for (auto it = pool.freeBuffers.begin(); it != pool.freeBuffers.end(); ++it)
+            {
+                if ((*it)->size >= size && (best == pool.freeBuffers.end() || (*it)->size < (*best)->size))
+                {
+                    best = it;
+                }
+            }
+            if (best != pool.freeBuffers.end())
+            {
+                std::shared_ptr<Buffer> stagingBuffer = *best;
+                pool.freeBuffers.erase(best);
+                return stagingBuffer;
+            }
+
+            VkDeviceSize capacity = MIN_STAGING_SIZE;
+            while (capacity < size)
+            {
+                capacity <<= 1;
+            }
+            std::shared_ptr<Buffer> stagingBuffer = std::make_shared<Buffer>();
+            allocate(stagingBuffer.get(), capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, 0, MemoryCategory::eStaging);
+            stagingBuffer->size = capacity;
+            return stagingBuffer;
+        }
+
+        void releaseStagingBuffer(const std::shared_ptr<Buffer> &stagingBuffer)
+        {
+            stagingPool().freeBuffers.push_back(stagingBuffer);
+        }
+
+        void destroyStagingPool()
+        {
+            stagingPool().freeBuffers.clear();
+        }
+
+        VkDeviceSize getBytesStaged()
+        {
+            return stagingPool().bytesStaged;
+        }
+
+        void uploadDeviceLocal(Buffer *buffer, VkDeviceSize offset, const void *data, VkDeviceSize size)
+        {
+            UploadBatch uploadBatch;
+            uploadBatch.copyToBuffer(buffer, offset, data, size);
+            uploadBatch.wait();
+        }
+
+        void allocateDeviceLocal(Buffer *buffer, const void *data, VkDeviceSize size, VkBufferUsageFlags usage)
+        {
+            allocate(buffer, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+            uploadDeviceLocal(buffer, 0, data, size);
+        }
+    }
+}
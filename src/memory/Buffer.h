@@ -6,6 +6,8 @@
 #include <iostream>
 #include <vector>
 #include "../app-context/VulkanApplicationContext.h"
+#include "../app-context/DeletionQueue.h"
+#include "MemoryStats.h"
 #include "../scene/Mesh.h"
 #include <memory>
 
@@ -13,18 +15,24 @@ namespace mcvkp
 {
     struct Buffer
     {
-        VkBuffer buffer;
-        VmaAllocation allocation;
-        VkDeviceSize size;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        // What the VkBuffer was created with, so the defragmenter can recreate it elsewhere.
+        VkBufferUsageFlags usage = 0;
+        VkDeviceSize allocatedSize = 0;
 
         ~Buffer()
         {
-            std::cout << "Destroying buffer"
-                      << "\n";
             if (buffer != VK_NULL_HANDLE)
             {
-                vmaDestroyBuffer(VulkanGlobal::context.getAllocator(), buffer, allocation);
-                buffer = VK_NULL_HANDLE;
+                VkBuffer buffer = this->buffer;
+                VmaAllocation allocation = this->allocation;
+                VulkanGlobal::deletionQueue.push([buffer, allocation]()
+                                                 {
+                                                     MemoryStats::untrack(allocation);
+                                                     vmaDestroyBuffer(VulkanGlobal::context.getAllocator(), buffer, allocation); });
+                this->buffer = VK_NULL_HANDLE;
             }
         }
 
@@ -56,7 +64,9 @@ namespace mcvkp
         void inline allocate(Buffer *buffer,
                              VkDeviceSize size,
                              VkBufferUsageFlags usage,
-                             VmaMemoryUsage memoryUsage)
+                             VmaMemoryUsage memoryUsage,
+                             VmaAllocationCreateFlags allocationFlags = 0,
+                             MemoryCategory category = MemoryCategory::eOther)
         {
             VkBufferCreateInfo bufferInfo{};
             bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -66,6 +76,8 @@ namespace mcvkp
 
             VmaAllocationCreateInfo vmaallocInfo = {};
             vmaallocInfo.usage = memoryUsage;
+            vmaallocInfo.flags = allocationFlags;
+            vmaallocInfo.pUserData = buffer;
 
             if (vmaCreateBuffer(VulkanGlobal::context.getAllocator(),
                                 &bufferInfo,
@@ -76,6 +88,9 @@ namespace mcvkp
             {
                 throw std::runtime_error("failed to create buffer");
             }
+            buffer->usage = usage;
+            buffer->allocatedSize = size;
+            MemoryStats::track(buffer->allocation, category);
         }
 
         template <typename T>
@@ -91,6 +106,33 @@ namespace mcvkp
             vmaUnmapMemory(VulkanGlobal::context.getAllocator(), buffer->allocation);
         }
 
+        // A host-visible transfer source of at least `size` bytes, recycled from the staging pool.
+        std::shared_ptr<Buffer> acquireStagingBuffer(VkDeviceSize size);
+
+        // Returns a staging buffer to the pool. The GPU must be done reading it.
+        void releaseStagingBuffer(const std::shared_ptr<Buffer> &stagingBuffer);
+
+        // Frees the pooled staging buffers. Call before the allocator is destroyed.
+        void destroyStagingPool();
+
+        // Total bytes copied through staging buffers so far.
+        VkDeviceSize getBytesStaged();
+
+        // Copies data into a range of a buffer created with TRANSFER_DST usage. Blocks until the copy is done.
+        void uploadDeviceLocal(Buffer *buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+
+        // Allocates a GPU_ONLY buffer and fills it through a staging buffer. Blocks until the copy is done.
+        void allocateDeviceLocal(Buffer *buffer, const void *data, VkDeviceSize size, VkBufferUsageFlags usage);
+
+        // Like create, but the buffer lives in device-local memory and cannot be mapped.
+        template <typename T>
+        void inline createDeviceLocal(Buffer *buffer, const T *elements, const size_t numElements, VkBufferUsageFlags usage)
+        {
+            buffer->size = sizeof(T);
+
+            allocateDeviceLocal(buffer, elements, numElements * sizeof(T), usage);
+        }
+
         template <typename T>
         void inline createBundle(BufferBundle *bufferBundle, const T *elements, const size_t numElements, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage)
         {
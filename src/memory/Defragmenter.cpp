@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "Defragmenter.h"
+#include "MemoryStats.h"
+#include "../app-context/DeletionQueue.h"
+
+namespace mcvkp
+{
+    namespace
+    {
+        // Start once at least this much free memory is fragmented, and it is at least a quarter of all block memory.
+        const VkDeviceSize MIN_FRAGMENTED_BYTES = 32 * 1024 * 1024;
+    }
+
+    Defragmenter::Defragmenter(std::function<void()> onResourcesMoved, double passTimeBudgetMs, VkDeviceSize maxBytesPerPass)
+        : m_onResourcesMoved(onResourcesMoved), m_passTimeBudget(passTimeBudgetMs), m_maxBytesPerPass(maxBytesPerPass),
+          m_context(VK_NULL_HANDLE), m_passInfo{}, m_commandBuffer(VK_NULL_HANDLE), m_passInFlight(false),
+          m_passRetiring(false), m_passBytesMoved(0), m_passNumMoved(0), m_blockBytesBeforePass(0), m_passIndex(0), m_lastRunMovedNothing(false), m_fragmentedBytesAtLastRun(0)
+    {
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(VulkanGlobal::context.getDevice(), &fenceInfo, nullptr, &m_fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create defragmentation fence!");
+        }
+    }
+
+    Defragmenter::~Defragmenter()
+    {
+        if (m_passInFlight)
+        {
+            // Throw the copies away instead of swapping them in; nothing is left to patch the descriptors.
+            vkWaitForFences(VulkanGlobal::context.getDevice(), 1, &m_fence, VK_TRUE, UINT64_MAX);
+            for (size_t i = 0; i < m_moves.size(); i++)
+            {
+                vkDestroyImageView(VulkanGlobal::context.getDevice(), m_moves[i].newImageView, nullptr);
+                vkDestroyImage(VulkanGlobal::context.getDevice(), m_moves[i].newImage, nullptr);
+                vkDestroyBuffer(VulkanGlobal::context.getDevice(), m_moves[i].newBuffer, nullptr);
+                m_passInfo.pMoves[i].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            }
+            vmaEndDefragmentationPass(VulkanGlobal::context.getAllocator(), m_context, &m_passInfo);
+            vkFreeCommandBuffers(VulkanGlobal::context.getDevice(), VulkanGlobal::context.getCommandPool(), 1, &m_commandBuffer);
+        }
+        else if (m_passRetiring)
+        {
+            // Only at shutdown, with the device idle. The old handles still go through the deletion queue.
+            vmaEndDefragmentationPass(VulkanGlobal::context.getAllocator(), m_context, &m_passInfo);
+        }
+        if (m_context != VK_NULL_HANDLE)
+        {
+            end();
+        }
+        vkDestroyFence(VulkanGlobal::context.getDevice(), m_fence, nullptr);
+    }
+
+    bool Defragmenter::isWorthRunning() const
+    {
+        VkDeviceSize blockBytes = 0;
+        VkDeviceSize fragmented = getFragmentedBytes(blockBytes);
+        // Nothing could be moved last time and the memory has not changed since.
+        if (m_lastRunMovedNothing && fragmented == m_fragmentedBytesAtLastRun)
+        {
+            return false;
+        }
+        return fragmented >= MIN_FRAGMENTED_BYTES && fragmented * 4 >= blockBytes;
+    }
+
+    void Defragmenter::start()
+    {
+        if (m_context != VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        VmaDefragmentationInfo defragmentationInfo{};
+        defragmentationInfo.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+        defragmentationInfo.maxBytesPerPass = m_maxBytesPerPass;
+        if (vmaBeginDefragmentation(VulkanGlobal::context.getAllocator(), &defragmentationInfo, &m_context) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin defragmentation!");
+        }
+        m_passIndex = 0;
+    }
+
+    bool Defragmenter::isRunning() const
+    {
+        return m_context != VK_NULL_HANDLE;
+    }
+
+    void Defragmenter::update()
+    {
+        if (m_context == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        if (m_passRetiring)
+        {
+            if (*m_passRetired)
+            {
+                retirePass();
+            }
+        }
+        else if (!m_passInFlight)
+        {
+            beginPass();
+        }
+        else if (vkGetFenceStatus(VulkanGlobal::context.getDevice(), m_fence) == VK_SUCCESS)
+        {
+            finishPass();
+        }
+    }
+
+    void Defragmenter::beginPass()
+    {
+        VkResult result = vmaBeginDefragmentationPass(VulkanGlobal::context.getAllocator(), m_context, &m_passInfo);
+        if (result == VK_SUCCESS)
+        {
+            // Nothing left to move.
+            end();
+            return;
+        }
+        if (result != VK_INCOMPLETE)
+        {
+            throw std::runtime_error("failed to begin defragmentation pass!");
+        }
+
+        m_blockBytesBeforePass = getBlockBytes();
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = VulkanGlobal::context.getCommandPool();
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(VulkanGlobal::context.getDevice(), &allocInfo, &m_commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate defragmentation command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(m_commandBuffer, &beginInfo);
+
+        // Moves that do not fit in the time budget are skipped; VMA leaves those allocations where they are.
+        auto passStart = std::chrono::steady_clock::now();
+        m_moves.assign(m_passInfo.moveCount, Move{});
+        size_t numRecorded = 0;
+        for (uint32_t i = 0; i < m_passInfo.moveCount; i++)
+        {
+            VmaDefragmentationMove &vmaMove = m_passInfo.pMoves[i];
+            bool recorded = false;
+            if (std::chrono::steady_clock::now() - passStart < m_passTimeBudget)
+            {
+                switch (MemoryStats::getCategory(vmaMove.srcAllocation))
+                {
+                case MemoryCategory::eGeometry:
+                    recorded = recordBufferMove(vmaMove, m_moves[i]);
+                    break;
+                case MemoryCategory::eTexture:
+                    recorded = recordImageMove(vmaMove, m_moves[i]);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            if (recorded)
+            {
+                numRecorded++;
+            }
+            else
+            {
+                vmaMove.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            }
+        }
+
+        // Make the copies visible to every later use of the new resources.
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkEndCommandBuffer(m_commandBuffer);
+
+        if (numRecorded == 0)
+        {
+            vkFreeCommandBuffers(VulkanGlobal::context.getDevice(), VulkanGlobal::context.getCommandPool(), 1, &m_commandBuffer);
+            if (vmaEndDefragmentationPass(VulkanGlobal::context.getAllocator(), m_context, &m_passInfo) == VK_SUCCESS)
+            {
+                end();
+            }
+            return;
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &m_commandBuffer;
+        if (vkQueueSubmit(VulkanGlobal::context.getGraphicsQueue(), 1, &submitInfo, m_fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit defragmentation commands!");
+        }
+        m_passInFlight = true;
+    }
+
+    void Defragmenter::finishPass()
+    {
+        // Frames in flight still read the old resources through their descriptor sets and command
+        // buffers, so those are destroyed once the frames are done rather than here.
+        std::vector<VkBuffer> oldBuffers;
+        std::vector<VkImage> oldImages;
+        std::vector<VkImageView> oldImageViews;
+        m_passBytesMoved = 0;
+        m_passNumMoved = 0;
+        for (Move &move : m_moves)
+        {
+            if (move.buffer != nullptr)
+            {
+                oldBuffers.push_back(move.buffer->buffer);
+                move.buffer->buffer = move.newBuffer;
+            }
+            else if (move.image != nullptr)
+            {
+                oldImageViews.push_back(move.image->imageView);
+                oldImages.push_back(move.image->image);
+                move.image->image = move.newImage;
+                move.image->imageView = move.newImageView;
+            }
+            else
+            {
+                continue;
+            }
+            m_passBytesMoved += move.size;
+            m_passNumMoved++;
+        }
+        m_moves.clear();
+
+        std::shared_ptr<bool> retired = std::make_shared<bool>(false);
+        VulkanGlobal::deletionQueue.push([oldBuffers, oldImages, oldImageViews, retired]()
+                                         {
+                                             for (VkBuffer buffer : oldBuffers)
+                                             {
+                                                 vkDestroyBuffer(VulkanGlobal::context.getDevice(), buffer, nullptr);
+                                             }
+                                             for (VkImageView imageView : oldImageViews)
+                                             {
+                                                 vkDestroyImageView(VulkanGlobal::context.getDevice(), imageView, nullptr);
+                                             }
+                                             for (VkImage image : oldImages)
+                                             {
+                                                 vkDestroyImage(VulkanGlobal::context.getDevice(), image, nullptr);
+                                             }
+                                             *retired = true; });
+        m_passRetired = retired;
+
+        vkFreeCommandBuffers(VulkanGlobal::context.getDevice(), VulkanGlobal::context.getCommandPool(), 1, &m_commandBuffer);
+        vkResetFences(VulkanGlobal::context.getDevice(), 1, &m_fence);
+        m_passInFlight = false;
+        m_passRetiring = true;
+
+        m_onResourcesMoved();
+    }
+
+    void Defragmenter::retirePass()
+    {
+        // VMA frees the memory the resources moved out of here, which is why this waits for the
+        // frames that read it instead of running in finishPass.
+        VkResult result = vmaEndDefragmentationPass(VulkanGlobal::context.getAllocator(), m_context, &m_passInfo);
+        m_passRetiring = false;
+        m_passRetired.reset();
+
+        VkDeviceSize blockBytes = getBlockBytes();
+        VkDeviceSize bytesFreed = m_blockBytesBeforePass > blockBytes ? m_blockBytesBeforePass - blockBytes : 0;
+        std::cout << "Defragmentation pass " << m_passIndex++ << ": moved " << m_passNumMoved << " allocations ("
+                  << m_passBytesMoved / 1024 << " KiB), freed " << bytesFreed / 1024 << " KiB\n";
+
+        if (result == VK_SUCCESS)
+        {
+            end();
+        }
+    }
+
+    void Defragmenter::end()
+    {
+        VmaDefragmentationStats stats{};
+        vmaEndDefragmentation(VulkanGlobal::context.getAllocator(), m_context, &stats);
+        m_context = VK_NULL_HANDLE;
+
+        VkDeviceSize blockBytes = 0;
+        m_lastRunMovedNothing = stats.allocationsMoved == 0;
+        m_fragmentedBytesAtLastRun = getFragmentedBytes(blockBytes);
+        if (m_lastRunMovedNothing)
+        {
+            return;
+        }
+
+        std::cout << "Defragmentation done: moved " << stats.allocationsMoved << " allocations ("
+                  << stats.bytesMoved / 1024 << " KiB), freed " << stats.deviceMemoryBlocksFreed << " blocks ("
+                  << stats.bytesFreed / 1024 << " KiB)\n";
+    }
+
+    bool Defragmenter::recordBufferMove(VmaDefragmentationMove &vmaMove, Move &move)
+    {
+        VmaAllocationInfo allocationInfo;
+        vmaGetAllocationInfo(VulkanGlobal::context.getAllocator(), vmaMove.srcAllocation, &allocationInfo);
+        Buffer *buffer = static_cast<Buffer *>(allocationInfo.pUserData);
+        if (buffer == nullptr || buffer->buffer == VK_NULL_HANDLE || (buffer->usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) == 0)
+        {
+            return false;
+        }
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = buffer->allocatedSize;
+        bufferInfo.usage = buffer->usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkBuffer newBuffer;
+        if (vkCreateBuffer(VulkanGlobal::context.getDevice(), &bufferInfo, nullptr, &newBuffer) != VK_SUCCESS)
+        {
+            return false;
+        }
+        if (vmaBindBufferMemory(VulkanGlobal::context.getAllocator(), vmaMove.dstTmpAllocation, newBuffer) != VK_SUCCESS)
+        {
+            vkDestroyBuffer(VulkanGlobal::context.getDevice(), newBuffer, nullptr);
+            return false;
+        }
+
+        VkBufferCopy copyRegion{};
+        copyRegion.size = buffer->allocatedSize;
+        vkCmdCopyBuffer(m_commandBuffer, buffer->buffer, newBuffer, 1, &copyRegion);
+
+        move.buffer = buffer;
+        move.newBuffer = newBuffer;
+        move.size = allocationInfo.size;
+        return true;
+    }
+
+    bool Defragmenter::recordImageMove(VmaDefragmentationMove &vmaMove, Move &move)
+    {
+        VmaAllocationInfo allocationInfo;
+        vmaGetAllocationInfo(VulkanGlobal::context.getAllocator(), vmaMove.srcAllocation, &allocationInfo);
+        Image *image = static_cast<Image *>(allocationInfo.pUserData);
+        VkImageUsageFlags copyUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        if (image == nullptr || image->image == VK_NULL_HANDLE || (image->usage & copyUsage) != copyUsage)
+        {
+            return false;
+        }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = image->width;
+        imageInfo.extent.height = image->height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = image->mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = image->format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = image->usage;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkImage newImage;
+        if (vkCreateImage(VulkanGlobal::context.getDevice(), &imageInfo, nullptr, &newImage) != VK_SUCCESS)
+        {
+            return false;
+        }
+        if (vmaBindImageMemory(VulkanGlobal::context.getAllocator(), vmaMove.dstTmpAllocation, newImage) != VK_SUCCESS)
+        {
+            vkDestroyImage(VulkanGlobal::context.getDevice(), newImage, nullptr);
+            return false;
+        }
+
+        // Textures are sampled in SHADER_READ_ONLY_OPTIMAL. The old one goes back to that layout because
+        // frames recorded before the pass finishes still sample it.
+        VkImageMemoryBarrier barriers[2]{};
+        for (VkImageMemoryBarrier &barrier : barriers)
+        {
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange.aspectMask = image->aspectFlags;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = image->mipLevels;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+        }
+        barriers[0].image = image->image;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[1].image = newImage;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 2, barriers);
+
+        std::vector<VkImageCopy> regions(image->mipLevels);
+        for (uint32_t level = 0; level < image->mipLevels; level++)
+        {
+            VkImageCopy &region = regions[level];
+            region.srcSubresource.aspectMask = image->aspectFlags;
+            region.srcSubresource.mipLevel = level;
+            region.srcSubresource.baseArrayLayer = 0;
+            region.srcSubresource.layerCount = 1;
+            region.dstSubresource = region.srcSubresource;
+            region.srcOffset = {0, 0, 0};
+            region.dstOffset = {0, 0, 0};
+            region.extent.width = std::max(image->width >> level, 1u);
+            region.extent.height = std::max(image->height >> level, 1u);
+            region.extent.depth = 1;
+        }
+        vkCmdCopyImage(m_commandBuffer, image->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       static_cast<uint32_t>(regions.size()), regions.data());
+
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 2, barriers);
+
+        move.image = image;
+        move.newImage = newImage;
+        move.newImageView = ImageUtils::createImageView(newImage, image->format, image->aspectFlags, image->mipLevels);
+        move.size = allocationInfo.size;
+        return true;
+    }
+
+    VkDeviceSize Defragmenter::getFragmentedBytes(VkDeviceSize &blockBytes) const
+    {
+        VmaTotalStatistics stats;
+        vmaCalculateStatistics(VulkanGlobal::context.getAllocator(), &stats);
+        blockBytes = stats.total.statistics.blockBytes;
+
+        // The largest free range of a memory type, such as the unused tail of a fresh block, is not
+        // fragmentation: compaction would not make it any bigger. Everything else free is.
+        VkDeviceSize fragmented = 0;
+        for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+        {
+            const VmaDetailedStatistics &type = stats.memoryType[i];
+            if (type.unusedRangeCount > 1)
+            {
+                VkDeviceSize free = type.statistics.blockBytes - type.statistics.allocationBytes;
+                fragmented += free - type.unusedRangeSizeMax;
+            }
+        }
+        return fragmented;
+    }
+
+    VkDeviceSize Defragmenter::getBlockBytes() const
+    {
+        VmaTotalStatistics stats;
+        vmaCalculateStatistics(VulkanGlobal::context.getAllocator(), &stats);
+        return stats.total.statistics.blockBytes;
+    }
+}
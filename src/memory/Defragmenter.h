@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "vk_mem_alloc.h"
+#include "Buffer.h"
+#include "Image.h"
+
+namespace mcvkp
+{
+    /**
+     * Compacts VMA memory blocks a few allocations at a time. Each pass recreates the moved
+     * geometry buffers and textures in their new place and copies them on the graphics queue.
+     * Once that copy has finished the owners get the new handles and onResourcesMoved runs so
+     * descriptor sets can be rebuilt. Frames in flight keep the old handles, which go through the
+     * deletion queue; the pass ends, and VMA frees the memory they moved out of, once those frames are done.
+     *
+     * Only buffers tagged eGeometry and images tagged eTexture move. Mapped uniform buffers cache
+     * their pointers and attachments are referenced by framebuffers, so VMA is told to skip them.
+     * The Buffer and Image objects of moving allocations must stay alive until the pass is over.
+     * Nothing waits for the device to go idle.
+     */
+    class Defragmenter
+    {
+    public:
+        // onResourcesMoved runs between frames, from update().
+        explicit Defragmenter(std::function<void()> onResourcesMoved,
+                              double passTimeBudgetMs = 2.0,
+                              VkDeviceSize maxBytesPerPass = 64 * 1024 * 1024);
+
+        ~Defragmenter();
+
+        Defragmenter(const Defragmenter &) = delete;
+        Defragmenter &operator=(const Defragmenter &) = delete;
+
+        // True when a good share of the memory in VMA's blocks is free but split up: free bytes
+        // outside the largest free range of their memory type, including whole spare blocks' worth.
+        // False again after a run that moved nothing, until the fragmentation changes.
+        bool isWorthRunning() const;
+
+        // Does nothing if a defragmentation is already running.
+        void start();
+
+        bool isRunning() const;
+
+        // Call once per frame. Starts the next pass, or finishes the current one once its copies are done.
+        void update();
+
+    private:
+        struct Move
+        {
+            Buffer *buffer = nullptr;
+            Image *image = nullptr;
+            VkBuffer newBuffer = VK_NULL_HANDLE;
+            VkImage newImage = VK_NULL_HANDLE;
+            VkImageView newImageView = VK_NULL_HANDLE;
+            VkDeviceSize size = 0;
+        };
+
+        void beginPass();
+        // Hands the new resources to their owners once the copies are done.
+        void finishPass();
+        // Ends the pass once no frame in flight reads the old resources anymore.
+        void retirePass();
+        void end();
+
+        // Both return false when the move has to be skipped.
+        bool recordBufferMove(VmaDefragmentationMove &vmaMove, Move &move);
+        bool recordImageMove(VmaDefragmentationMove &vmaMove, Move &move);
+
+        VkDeviceSize getBlockBytes() const;
+        // Free bytes outside the largest free range of each memory type.
+        VkDeviceSize getFragmentedBytes(VkDeviceSize &blockBytes) const;
+
+        std::function<void()> m_onResourcesMoved;
+        std::chrono::duration<double, std::milli> m_passTimeBudget;
+        VkDeviceSize m_maxBytesPerPass;
+
+        VmaDefragmentationContext m_context;
+        VmaDefragmentationPassMoveInfo m_passInfo;
+        std::vector<Move> m_moves;
+        VkCommandBuffer m_commandBuffer;
+        VkFence m_fence;
+        bool m_passInFlight;
+        // Between finishPass and retirePass. Set by the deletion queue when the old resources are gone.
+        bool m_passRetiring;
+        std::shared_ptr<bool> m_passRetired;
+        VkDeviceSize m_passBytesMoved;
+        uint32_t m_passNumMoved;
+        VkDeviceSize m_blockBytesBeforePass;
+        uint32_t m_passIndex;
+        bool m_lastRunMovedNothing;
+        VkDeviceSize m_fragmentedBytesAtLastRun;
+    };
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <stdexcept>
+#include "UploadBatch.h"
+#include "GeometryArena.h"
+
+namespace mcvkp
+{
+    GeometryArena &GeometryArena::get()
+    {
+        static GeometryArena arena;
+        return arena;
+    }
+
+    GeometryArena::Allocation GeometryArena::allocateVertices(const void *vertices, size_t numVertices, uint32_t stride, UploadBatch *uploadBatch)
+    {
+        return allocate(vertices, numVertices * stride, stride, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_INDEX_TYPE_MAX_ENUM, VERTEX_PAGE_SIZE, uploadBatch);
+    }
+
+    GeometryArena::Allocation GeometryArena::allocateIndices(const void *indices, size_t numIndices, VkIndexType indexType, UploadBatch *uploadBatch)
+    {
+        uint32_t indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        return allocate(indices, numIndices * indexSize, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexType, INDEX_PAGE_SIZE, uploadBatch);
+    }
+
+    GeometryArena::Allocation GeometryArena::allocate(const void *data, VkDeviceSize size, uint32_t elementSize,
+                                                      VkBufferUsageFlags usage, VkIndexType indexType, VkDeviceSize pageSize, UploadBatch *uploadBatch)
+    {
+        // Zero-sized ranges would collide with their neighbours in the free list. Only the data is copied.
+        VkDeviceSize dataSize = size;
+        size = std::max<VkDeviceSize>(size, elementSize);
+
+        Allocation allocation{};
+        allocation.elementSize = elementSize;
+        bool found = false;
+        for (uint32_t p = 0; p < m_pages.size() && !found; p++)
+        {
+            if (m_pages[p].usage == usage && m_pages[p].indexType == indexType)
+            {
+                found = allocateFromPage(p, size, elementSize, allocation);
+            }
+        }
+
+        if (!found)
+        {
+            Page page;
+            page.buffer = std::make_shared<Buffer>();
+            page.usage = usage;
+            page.indexType = indexType;
+            page.capacity = std::max(pageSize, size);
+            BufferUtils::allocate(page.buffer.get(), page.capacity, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_GPU_ONLY,
+                                  0, MemoryCategory::eGeometry);
+            page.freeRanges[0] = page.capacity;
+            m_pages.push_back(page);
+            allocateFromPage(static_cast<uint32_t>(m_pages.size() - 1), size, elementSize, allocation);
+        }
+
+        if (data != nullptr && dataSize > 0 && uploadBatch != nullptr)
+        {
+            uploadBatch->copyToBuffer(m_pages[allocation.page].buffer.get(), allocation.offset, data, dataSize);
+        }
+        else if (data != nullptr && dataSize > 0)
+        {
+            BufferUtils::uploadDeviceLocal(m_pages[allocation.page].buffer.get(), allocation.offset, data, dataSize);
+        }
+        m_bytesAllocated += allocation.size;
+        return allocation;
+    }
+
+    bool GeometryArena::allocateFromPage(uint32_t pageIndex, VkDeviceSize size, uint32_t alignment, Allocation &allocation)
+    {
+        std::map<VkDeviceSize, VkDeviceSize> &freeRanges = m_pages[pageIndex].freeRanges;
+        for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+        {
+            VkDeviceSize rangeStart = it->first;
+            VkDeviceSize rangeEnd = it->first + it->second;
+            // vertexOffset and firstIndex count elements, so the range must start on an element boundary.
+            VkDeviceSize start = (rangeStart + alignment - 1) / alignment * alignment;
+            if (start + size > rangeEnd)
+            {
+                continue;
+            }
+
+            freeRanges.erase(it);
+            if (start > rangeStart)
+            {
+                freeRanges[rangeStart] = start - rangeStart;
+            }
+            if (start + size < rangeEnd)
+            {
+                freeRanges[start + size] = rangeEnd - (start + size);
+            }
+
+            allocation.page = pageIndex;
+            allocation.offset = start;
+            allocation.size = size;
+            return true;
+        }
+        return false;
+    }
+
+    void GeometryArena::free(const Allocation &allocation)
+    {
+        std::map<VkDeviceSize, VkDeviceSize> &freeRanges = m_pages[allocation.page].freeRanges;
+        VkDeviceSize start = allocation.offset;
+        VkDeviceSize size = allocation.size;
+
+        auto next = freeRanges.lower_bound(start);
+        if (next != freeRanges.begin())
+        {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == start)
+            {
+                start = previous->first;
+                size += previous->second;
+                freeRanges.erase(previous);
+            }
+        }
+        if (next != freeRanges.end() && next->first == allocation.offset + allocation.size)
+        {
+            size += next->second;
+            freeRanges.erase(next);
+        }
+        freeRanges[start] = size;
+
+        m_bytesAllocated -= allocation.size;
+    }
+
+    void GeometryArena::bind(VkCommandBuffer commandBuffer, const Allocation &vertices, const Allocation &indices, BindState &state) const
+    {
+        VkBuffer vertexBuffer = m_pages[vertices.page].buffer->buffer;
+        if (vertexBuffer != state.vertexBuffer)
+        {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+            state.vertexBuffer = vertexBuffer;
+        }
+
+        const Page &indexPage = m_pages[indices.page];
+        if (indexPage.buffer->buffer != state.indexBuffer || indexPage.indexType != state.indexType)
+        {
+            vkCmdBindIndexBuffer(commandBuffer, indexPage.buffer->buffer, 0, indexPage.indexType);
+            state.indexBuffer = indexPage.buffer->buffer;
+            state.indexType = indexPage.indexType;
+        }
+    }
+
+    VkDeviceSize GeometryArena::getBytesAllocated() const
+    {
+        return m_bytesAllocated;
+    }
+
+    VkDeviceSize GeometryArena::getBytesReserved() const
+    {
+        VkDeviceSize reserved = 0;
+        for (const Page &page : m_pages)
+        {
+            reserved += page.capacity;
+        }
+        return reserved;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "Buffer.h"
+
+namespace mcvkp
+{
+    class UploadBatch;
+
+    /**
+     * Large device-local vertex and index buffers shared by every model. Models get ranges from a
+     * first-fit free list and draw with vertexOffset / firstIndex, so consecutive draws from the
+     * same pages need no rebinding. Vertices of any stride share the vertex pages; 16-bit and
+     * 32-bit indices live in separate pages because the index type is part of the binding.
+     */
+    class GeometryArena
+    {
+    public:
+        static const VkDeviceSize VERTEX_PAGE_SIZE = 32 << 20;
+        static const VkDeviceSize INDEX_PAGE_SIZE = 16 << 20;
+
+        struct Allocation
+        {
+            uint32_t page;
+            VkDeviceSize offset;
+            VkDeviceSize size;
+            uint32_t elementSize;
+
+            // vertexOffset for vertex ranges, firstIndex for index ranges.
+            uint32_t firstElement() const
+            {
+                return static_cast<uint32_t>(offset / elementSize);
+            }
+        };
+
+        // Buffers last bound in a command buffer. Start each pass with a default one.
+        struct BindState
+        {
+            VkBuffer vertexBuffer = VK_NULL_HANDLE;
+            VkBuffer indexBuffer = VK_NULL_HANDLE;
+            VkIndexType indexType = VK_INDEX_TYPE_MAX_ENUM;
+        };
+
+        static GeometryArena &get();
+
+        // Uploads the vertices into a range aligned to the stride. The copy is recorded into the batch if
+        // there is one, otherwise this blocks until it is done.
+        Allocation allocateVertices(const void *vertices, size_t numVertices, uint32_t stride, UploadBatch *uploadBatch = nullptr);
+
+        // indexType is VK_INDEX_TYPE_UINT16 or VK_INDEX_TYPE_UINT32.
+        Allocation allocateIndices(const void *indices, size_t numIndices, VkIndexType indexType, UploadBatch *uploadBatch = nullptr);
+
+        void free(const Allocation &allocation);
+
+        // Binds the pages holding the two ranges, skipping whatever the state says is bound already.
+        void bind(VkCommandBuffer commandBuffer, const Allocation &vertices, const Allocation &indices, BindState &state) const;
+
+        VkDeviceSize getBytesAllocated() const;
+        VkDeviceSize getBytesReserved() const;
+
+    private:
+        struct Page
+        {
+            std::shared_ptr<Buffer> buffer;
+            VkBufferUsageFlags usage;
+            VkIndexType indexType;
+            VkDeviceSize capacity;
+            // Free ranges, offset to size. Neighbouring ranges are always merged.
+            std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+        };
+
+        std::vector<Page> m_pages;
+        VkDeviceSize m_bytesAllocated = 0;
+
+        GeometryArena() = default;
+
+        Allocation allocate(const void *data, VkDeviceSize size, uint32_t elementSize,
+                            VkBufferUsageFlags usage, VkIndexType indexType, VkDeviceSize pageSize, UploadBatch *uploadBatch);
+
+        bool allocateFromPage(uint32_t pageIndex, VkDeviceSize size, uint32_t alignment, Allocation &allocation);
+    };
+}
@@ -1,8 +1,11 @@
 #include <iostream>
 #include <string>
 #include <cmath>
+#include <cstring>
 #include "vk_mem_alloc.h"
 #include "Buffer.h"
+#include "../app-context/DeletionQueue.h"
+#include "UploadBatch.h"
 #include "../render-context/RenderSystem.h"
 #include "../utils/StbImageImpl.h"
 #include "Image.h"
@@ -19,11 +22,17 @@ namespace mcvkp
     {
         if (image != VK_NULL_HANDLE)
         {
-            vkDestroyImageView(VulkanGlobal::context.getDevice(), imageView, nullptr);
-            vkDestroyImage(VulkanGlobal::context.getDevice(), image, nullptr);
-            vmaFreeMemory(VulkanGlobal::context.getAllocator(), allocation);
-
-            image = VK_NULL_HANDLE;
+            VkImage image = this->image;
+            VkImageView imageView = this->imageView;
+            VmaAllocation allocation = this->allocation;
+            VulkanGlobal::deletionQueue.push([image, imageView, allocation]()
+                                             {
+                                                 vkDestroyImageView(VulkanGlobal::context.getDevice(), imageView, nullptr);
+                                                 vkDestroyImage(VulkanGlobal::context.getDevice(), image, nullptr);
+                                                 MemoryStats::untrack(allocation);
+                                                 vmaFreeMemory(VulkanGlobal::context.getAllocator(), allocation); });
+
+            this->image = VK_NULL_HANDLE;
         }
     }
 
@@ -73,10 +82,15 @@ namespace mcvkp
                          VkImageUsageFlags usage,
                          VkImageAspectFlags aspectFlags,
                          VmaMemoryUsage memoryUsage,
+                         MemoryCategory category,
                          std::shared_ptr<Image> allocatedImage)
         {
             allocatedImage->width = width;
             allocatedImage->height = height;
+            allocatedImage->mipLevels = mipLevels;
+            allocatedImage->format = format;
+            allocatedImage->usage = usage;
+            allocatedImage->aspectFlags = aspectFlags;
 
             VkImageCreateInfo imageInfo{};
             imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -95,6 +109,7 @@ namespace mcvkp
 
             VmaAllocationCreateInfo vmaallocInfo = {};
             vmaallocInfo.usage = memoryUsage;
+            vmaallocInfo.pUserData = allocatedImage.get();
 
             if (vmaCreateImage(VulkanGlobal::context.getAllocator(),
                                &imageInfo,
@@ -105,19 +120,20 @@ namespace mcvkp
             {
                 throw std::runtime_error("failed to create buffer");
             }
+            MemoryStats::track(allocatedImage->allocation, category);
             allocatedImage->imageView = createImageView(allocatedImage->image,
                                                         format,
                                                         aspectFlags,
                                                         mipLevels);
         }
 
-        void transitionImageLayout(VkImage image,
+        void transitionImageLayout(VkCommandBuffer commandBuffer,
+                                   VkImage image,
                                    VkFormat format,
                                    VkImageLayout oldLayout,
                                    VkImageLayout newLayout,
                                    const uint32_t &mipLevels)
         {
-            VkCommandBuffer commandBuffer = RenderSystem::beginSingleTimeCommands();
             VkImageMemoryBarrier barrier{};
             barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
             barrier.oldLayout = oldLayout;
@@ -175,13 +191,21 @@ namespace mcvkp
                 0, nullptr,
                 0, nullptr,
                 1, &barrier);
+        }
 
+        void transitionImageLayout(VkImage image,
+                                   VkFormat format,
+                                   VkImageLayout oldLayout,
+                                   VkImageLayout newLayout,
+                                   const uint32_t &mipLevels)
+        {
+            VkCommandBuffer commandBuffer = RenderSystem::beginSingleTimeCommands();
+            transitionImageLayout(commandBuffer, image, format, oldLayout, newLayout, mipLevels);
             RenderSystem::endSingleTimeCommands(commandBuffer);
         }
 
-        void copyBufferToImage(const VkBuffer &buffer, VkImage image, uint32_t width, uint32_t height)
+        void copyBufferToImage(VkCommandBuffer commandBuffer, const VkBuffer &buffer, VkImage image, uint32_t width, uint32_t height)
         {
-            VkCommandBuffer commandBuffer = RenderSystem::beginSingleTimeCommands();
             VkBufferImageCopy region{};
             region.bufferOffset = 0;
             region.bufferRowLength = 0;
@@ -205,11 +229,17 @@ namespace mcvkp
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 1,
                 &region);
+        }
 
+        void copyBufferToImage(const VkBuffer &buffer, VkImage image, uint32_t width, uint32_t height)
+        {
+            VkCommandBuffer commandBuffer = RenderSystem::beginSingleTimeCommands();
+            copyBufferToImage(commandBuffer, buffer, image, width, height);
             RenderSystem::endSingleTimeCommands(commandBuffer);
         }
 
-        void generateMipmaps(VkImage image,
+        void generateMipmaps(VkCommandBuffer commandBuffer,
+                             VkImage image,
                              VkFormat imageFormat,
                              int32_t texWidth,
                              int32_t texHeight,
@@ -224,8 +254,6 @@ namespace mcvkp
                 throw std::runtime_error("texture image format does not support linear blitting!");
             }
 
-            VkCommandBuffer commandBuffer = RenderSystem::beginSingleTimeCommands();
-
             VkImageMemoryBarrier barrier{};
             barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
             barrier.image = image;
@@ -301,13 +329,31 @@ namespace mcvkp
                                  0, nullptr,
                                  0, nullptr,
                                  1, &barrier);
+        }
 
+        void generateMipmaps(VkImage image,
+                             VkFormat imageFormat,
+                             int32_t texWidth,
+                             int32_t texHeight,
+                             const uint32_t &mipLevels)
+        {
+            VkCommandBuffer commandBuffer = RenderSystem::beginSingleTimeCommands();
+            generateMipmaps(commandBuffer, image, imageFormat, texWidth, texHeight, mipLevels);
             RenderSystem::endSingleTimeCommands(commandBuffer);
         }
 
         void createTextureImage(const std::string &path,
                                 std::shared_ptr<Image> allocatedImage,
                                 uint32_t &mipLevels)
+        {
+            UploadBatch uploadBatch;
+            createTextureImage(path, allocatedImage, mipLevels, uploadBatch);
+        }
+
+        void createTextureImage(const std::string &path,
+                                std::shared_ptr<Image> allocatedImage,
+                                uint32_t &mipLevels,
+                                UploadBatch &uploadBatch)
         {
             int texWidth, texHeight, texChannels;
             // std::string path = path_prefix + "/textures/viking_room.png";
@@ -322,8 +368,7 @@ namespace mcvkp
                 throw std::runtime_error("failed to load texture image!");
             }
 
-            mcvkp::Buffer stagingBuffer;
-            BufferUtils::create(&stagingBuffer, tex.pixels, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+            std::shared_ptr<mcvkp::Buffer> stagingBuffer = uploadBatch.stage(tex.pixels, imageSize);
 
             createImage(texWidth,
                         texHeight,
@@ -334,16 +379,20 @@ namespace mcvkp
                         VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                         VK_IMAGE_ASPECT_COLOR_BIT,
                         VMA_MEMORY_USAGE_GPU_ONLY,
+                        MemoryCategory::eTexture,
                         allocatedImage);
             std::cout << "creating texture" << std::endl;
-            transitionImageLayout(allocatedImage->image,
+            VkCommandBuffer transferCommandBuffer = uploadBatch.getTransferCommandBuffer();
+            transitionImageLayout(transferCommandBuffer,
+                                  allocatedImage->image,
                                   VK_FORMAT_R8G8B8A8_SRGB,
                                   VK_IMAGE_LAYOUT_UNDEFINED,
                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                   mipLevels);
-            copyBufferToImage(stagingBuffer.buffer, allocatedImage->image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-            generateMipmaps(allocatedImage->image, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
-            // stagingBuffer.destroy();
+            copyBufferToImage(transferCommandBuffer, stagingBuffer->buffer, allocatedImage->image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+            // Blits need a graphics queue.
+            uploadBatch.transferImageOwnership(allocatedImage->image, mipLevels);
+            generateMipmaps(uploadBatch.getGraphicsCommandBuffer(), allocatedImage->image, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
         }
 
         void createTextureSampler(std::shared_ptr<VkSampler> textureSampler, uint32_t &mipLevels)
@@ -383,6 +432,15 @@ namespace mcvkp
         ImageUtils::createTextureSampler(m_sampler, m_mips);
     }
 
+    Texture::Texture(const std::string &path, UploadBatch &uploadBatch)
+    {
+        m_image = std::make_shared<Image>();
+        m_sampler = std::make_shared<VkSampler>();
+
+        ImageUtils::createTextureImage(path, m_image, m_mips, uploadBatch);
+        ImageUtils::createTextureSampler(m_sampler, m_mips);
+    }
+
     Texture::Texture(const std::shared_ptr<Image> &image) : m_image(image)
     {
         m_sampler = std::make_shared<VkSampler>();
@@ -391,7 +449,9 @@ namespace mcvkp
 
     Texture::~Texture()
     {
-        vkDestroySampler(VulkanGlobal::context.getDevice(), *m_sampler, nullptr);
+        VkSampler sampler = *m_sampler;
+        VulkanGlobal::deletionQueue.push([sampler]()
+                                         { vkDestroySampler(VulkanGlobal::context.getDevice(), sampler, nullptr); });
     }
 
     VkDescriptorImageInfo Texture::getDescriptorInfo()
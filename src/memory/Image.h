@@ -5,9 +5,12 @@
 #include <memory>
 #include <string>
 #include "vk_mem_alloc.h"
+#include "MemoryStats.h"
 
 namespace mcvkp
 {
+    class UploadBatch;
+
     class Image
     {
     public:
@@ -16,6 +19,11 @@ namespace mcvkp
         VkImageView imageView;
         uint32_t width;
         uint32_t height;
+        // What the VkImage was created with, so the defragmenter can recreate it elsewhere.
+        uint32_t mipLevels;
+        VkFormat format;
+        VkImageUsageFlags usage;
+        VkImageAspectFlags aspectFlags;
 
         ~Image();
         void destroy();
@@ -38,16 +46,34 @@ namespace mcvkp
                          VkImageUsageFlags usage,
                          VkImageAspectFlags aspectFlags,
                          VmaMemoryUsage memoryUsage,
+                         MemoryCategory category,
                          std::shared_ptr<Image> allocatedImage);
 
+        // The overloads taking a command buffer only record; the others submit and wait on their own.
+        void transitionImageLayout(VkCommandBuffer commandBuffer,
+                                   VkImage image,
+                                   VkFormat format,
+                                   VkImageLayout oldLayout,
+                                   VkImageLayout newLayout,
+                                   const uint32_t &mipLevels);
+
         void transitionImageLayout(VkImage image,
                                    VkFormat format,
                                    VkImageLayout oldLayout,
                                    VkImageLayout newLayout,
                                    const uint32_t &mipLevels);
 
+        void copyBufferToImage(VkCommandBuffer commandBuffer, const VkBuffer &buffer, VkImage image, uint32_t width, uint32_t height);
+
         void copyBufferToImage(const VkBuffer &buffer, VkImage image, uint32_t width, uint32_t height);
 
+        void generateMipmaps(VkCommandBuffer commandBuffer,
+                             VkImage image,
+                             VkFormat imageFormat,
+                             int32_t texWidth,
+                             int32_t texHeight,
+                             const uint32_t &mipLevels);
+
         void generateMipmaps(VkImage image,
                              VkFormat imageFormat,
                              int32_t texWidth,
@@ -55,9 +81,15 @@ namespace mcvkp
                              const uint32_t &mipLevels);
 
         void createTextureImage(const std::string &path,
-                                Image &allocatedImage,
+                                std::shared_ptr<Image> allocatedImage,
                                 uint32_t &mipLevels);
 
+        // Records the upload into the batch. The image is ready once the batch completes.
+        void createTextureImage(const std::string &path,
+                                std::shared_ptr<Image> allocatedImage,
+                                uint32_t &mipLevels,
+                                UploadBatch &uploadBatch);
+
         void createTextureSampler(std::shared_ptr<VkSampler> textureSampler, uint32_t &mipLevels);
     }
 
@@ -65,6 +97,7 @@ namespace mcvkp
     {
     public:
         Texture(const std::string &path);
+        Texture(const std::string &path, UploadBatch &uploadBatch);
         Texture(const std::shared_ptr<Image> &image);
 
         ~Texture();
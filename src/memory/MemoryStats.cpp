@@ -0,0 +1,163 @@
+#include "MemoryStats.h"
+#include "../app-context/VulkanApplicationContext.h"
+#include <array>
+#include <fstream>
+#include <unordered_map>
+
+namespace mcvkp
+{
+    namespace
+    {
+        struct TrackedAllocation
+        {
+            MemoryCategory category;
+            VkDeviceSize size;
+        };
+
+        struct Tracker
+        {
+            std::unordered_map<VmaAllocation, TrackedAllocation> allocations;
+            std::array<MemoryStats::CategoryUsage, static_cast<size_t>(MemoryCategory::eCount)> usage;
+        };
+
+        Tracker &tracker()
+        {
+            // Never destroyed: buffers owned by globals are untracked while the globals are torn down,
+            // and the leak report runs from the context destructor.
+            static Tracker *instance = new Tracker();
+            return *instance;
+        }
+
+        const VkDeviceSize MIB = 1024 * 1024;
+    }
+
+    namespace MemoryStats
+    {
+        const char *getCategoryName(MemoryCategory category)
+        {
+            switch (category)
+            {
+            case MemoryCategory::eGeometry:
+                return "geometry";
+            case MemoryCategory::eTexture:
+                return "textures";
+            case MemoryCategory::eAttachment:
+                return "attachments";
+            case MemoryCategory::eUniform:
+                return "uniforms";
+            case MemoryCategory::eStaging:
+                return "staging";
+            default:
+                return "other";
+            }
+        }
+
+        void track(VmaAllocation allocation, MemoryCategory category)
+        {
+            VmaAllocationInfo allocationInfo;
+            vmaGetAllocationInfo(VulkanGlobal::context.getAllocator(), allocation, &allocationInfo);
+            // Shows up in the JSON dump next to each allocation.
+            vmaSetAllocationName(VulkanGlobal::context.getAllocator(), allocation, getCategoryName(category));
+
+            tracker().allocations[allocation] = {category, allocationInfo.size};
+            CategoryUsage &usage = tracker().usage[static_cast<size_t>(category)];
+            usage.allocationCount++;
+            usage.bytes += allocationInfo.size;
+        }
+
+        void untrack(VmaAllocation allocation)
+        {
+            auto it = tracker().allocations.find(allocation);
+            if (it == tracker().allocations.end())
+            {
+                return;
+            }
+
+            CategoryUsage &usage = tracker().usage[static_cast<size_t>(it->second.category)];
+            usage.allocationCount--;
+            usage.bytes -= it->second.size;
+            tracker().allocations.erase(it);
+        }
+
+        CategoryUsage getCategoryUsage(MemoryCategory category)
+        {
+            return tracker().usage[static_cast<size_t>(category)];
+        }
+
+        MemoryCategory getCategory(VmaAllocation allocation)
+        {
+            auto it = tracker().allocations.find(allocation);
+            return it == tracker().allocations.end() ? MemoryCategory::eOther : it->second.category;
+        }
+
+        void setFrameIndex(uint32_t frameIndex)
+        {
+            vmaSetCurrentFrameIndex(VulkanGlobal::context.getAllocator(), frameIndex);
+        }
+
+        std::vector<VmaBudget> getHeapBudgets()
+        {
+            const VkPhysicalDeviceMemoryProperties *memoryProperties;
+            vmaGetMemoryProperties(VulkanGlobal::context.getAllocator(), &memoryProperties);
+
+            std::vector<VmaBudget> budgets(memoryProperties->memoryHeapCount);
+            vmaGetHeapBudgets(VulkanGlobal::context.getAllocator(), budgets.data());
+            return budgets;
+        }
+
+        void printReport(std::ostream &out)
+        {
+            std::vector<VmaBudget> budgets = getHeapBudgets();
+            for (size_t i = 0; i < budgets.size(); i++)
+            {
+                out << "heap " << i << ": " << budgets[i].usage / MIB << "/" << budgets[i].budget / MIB << " MiB, "
+                    << budgets[i].statistics.allocationCount << " allocations in "
+                    << budgets[i].statistics.blockCount << " blocks\n";
+            }
+
+            for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::eCount); i++)
+            {
+                CategoryUsage usage = tracker().usage[i];
+                out << (i == 0 ? "" : ", ") << getCategoryName(static_cast<MemoryCategory>(i)) << " "
+                    << usage.allocationCount << " (" << usage.bytes / 1024 << " KiB)";
+            }
+            out << "\n";
+        }
+
+        std::string buildDetailedStatsJson()
+        {
+            char *statsString;
+            vmaBuildStatsString(VulkanGlobal::context.getAllocator(), &statsString, VK_TRUE);
+            std::string json(statsString);
+            vmaFreeStatsString(VulkanGlobal::context.getAllocator(), statsString);
+            return json;
+        }
+
+        bool writeDetailedStatsJson(const std::string &path)
+        {
+            std::ofstream file(path);
+            if (!file)
+            {
+                return false;
+            }
+            file << buildDetailedStatsJson();
+            return static_cast<bool>(file);
+        }
+
+        size_t reportLeaks(std::ostream &out)
+        {
+            const auto &allocations = tracker().allocations;
+            if (allocations.empty())
+            {
+                return 0;
+            }
+
+            out << allocations.size() << " allocations still alive at shutdown:\n";
+            for (const auto &entry : allocations)
+            {
+                out << "  " << getCategoryName(entry.second.category) << ": " << entry.second.size << " bytes\n";
+            }
+            return allocations.size();
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../utils/vulkan.h"
+#include "vk_mem_alloc.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mcvkp
+{
+    // What an allocation is for. Every buffer and image allocation is tagged with one.
+    enum class MemoryCategory
+    {
+        eGeometry,
+        eTexture,
+        eAttachment,
+        eUniform,
+        eStaging,
+        eOther,
+        eCount
+    };
+
+    namespace MemoryStats
+    {
+        struct CategoryUsage
+        {
+            uint32_t allocationCount = 0;
+            VkDeviceSize bytes = 0;
+        };
+
+        const char *getCategoryName(MemoryCategory category);
+
+        // Called right after an allocation is created / right before it is freed.
+        void track(VmaAllocation allocation, MemoryCategory category);
+        void untrack(VmaAllocation allocation);
+
+        CategoryUsage getCategoryUsage(MemoryCategory category);
+
+        // eOther for allocations that are not tracked.
+        MemoryCategory getCategory(VmaAllocation allocation);
+
+        // Lets VMA refresh its budget numbers. Call once per frame.
+        void setFrameIndex(uint32_t frameIndex);
+
+        // One entry per memory heap. Usage and budget come from VK_EXT_memory_budget when the
+        // device has it, otherwise they are VMA's own estimates.
+        std::vector<VmaBudget> getHeapBudgets();
+
+        // Per-heap usage against budget followed by usage per category.
+        void printReport(std::ostream &out);
+
+        // VMA's detailed statistics, including every live allocation, as JSON.
+        std::string buildDetailedStatsJson();
+
+        // Returns false if the file could not be written.
+        bool writeDetailedStatsJson(const std::string &path);
+
+        // Lists the allocations that are still tracked and returns how many there are.
+        // Call before the allocator is destroyed.
+        size_t reportLeaks(std::ostream &out);
+    }
+}
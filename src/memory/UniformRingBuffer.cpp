@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <stdexcept>
+#include "UniformRingBuffer.h"
+
+namespace mcvkp
+{
+    UniformRingBuffer::UniformRingBuffer(size_t numFrames, VkDeviceSize capacity) : m_capacity(capacity), m_head(0)
+    {
+        m_alignment = std::max<VkDeviceSize>(VulkanGlobal::context.getMinUniformBufferOffsetAlignment(), 1);
+        m_bufferBundle = std::make_shared<BufferBundle>(numFrames);
+        for (const std::shared_ptr<Buffer> &buffer : m_bufferBundle->buffers)
+        {
+            BufferUtils::allocate(buffer.get(), m_capacity, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                  VMA_ALLOCATION_CREATE_MAPPED_BIT, MemoryCategory::eUniform);
+            buffer->size = m_capacity;
+
+            VmaAllocationInfo allocationInfo;
+            vmaGetAllocationInfo(VulkanGlobal::context.getAllocator(), buffer->allocation, &allocationInfo);
+            m_mappedSlots.push_back(static_cast<uint8_t *>(allocationInfo.pMappedData));
+        }
+    }
+
+    UniformRingBuffer::Allocation UniformRingBuffer::allocate(VkDeviceSize size)
+    {
+        VkDeviceSize offset = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+        if (offset + size > m_capacity)
+        {
+            throw std::runtime_error("uniform ring buffer is out of space!");
+        }
+        m_head = offset + size;
+        return {static_cast<uint32_t>(offset), size};
+    }
+
+    void UniformRingBuffer::flush(size_t frame)
+    {
+        vmaFlushAllocation(VulkanGlobal::context.getAllocator(), m_bufferBundle->buffers[frame]->allocation, 0, m_head);
+    }
+
+    const std::shared_ptr<BufferBundle> &UniformRingBuffer::getBufferBundle() const
+    {
+        return m_bufferBundle;
+    }
+
+    size_t UniformRingBuffer::getNumFrames() const
+    {
+        return m_mappedSlots.size();
+    }
+}
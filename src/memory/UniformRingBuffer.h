@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "vk_mem_alloc.h"
+#include "Buffer.h"
+
+namespace mcvkp
+{
+    /**
+     * Uniform data for every frame in flight in one persistently mapped buffer per frame slot.
+     * Sub-allocations are made once, at the same aligned offset in every slot, and bound as
+     * dynamic uniform buffers, so per-frame updates are plain writes through get().
+     */
+    class UniformRingBuffer
+    {
+    public:
+        struct Allocation
+        {
+            // Offset inside a frame slot, also the dynamic offset to bind with.
+            uint32_t offset;
+            VkDeviceSize size;
+        };
+
+        // Persistently mapped allocations are unmapped when ~Buffer destroys them.
+        UniformRingBuffer(size_t numFrames, VkDeviceSize capacity = 1 << 16);
+
+        // Reserves `size` bytes at the next offset aligned to minUniformBufferOffsetAlignment.
+        Allocation allocate(VkDeviceSize size);
+
+        // Allocates room for a T and writes the value to every frame slot.
+        template <typename T>
+        Allocation allocateInitialized(const T &initialValue)
+        {
+            Allocation allocation = allocate(sizeof(T));
+            for (size_t frame = 0; frame < m_mappedSlots.size(); frame++)
+            {
+                *get<T>(allocation, frame) = initialValue;
+            }
+            return allocation;
+        }
+
+        template <typename T>
+        T *get(const Allocation &allocation, size_t frame)
+        {
+            return reinterpret_cast<T *>(m_mappedSlots[frame] + allocation.offset);
+        }
+
+        // Makes the writes to a frame slot visible to the device. No-op on host-coherent memory.
+        void flush(size_t frame);
+
+        const std::shared_ptr<BufferBundle> &getBufferBundle() const;
+
+        size_t getNumFrames() const;
+
+    private:
+        std::shared_ptr<BufferBundle> m_bufferBundle;
+        std::vector<uint8_t *> m_mappedSlots;
+        VkDeviceSize m_capacity;
+        VkDeviceSize m_alignment;
+        VkDeviceSize m_head;
+    };
+}
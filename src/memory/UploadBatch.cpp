@@ -0,0 +1,276 @@
+#include <cstring>
+#include <stdexcept>
+#include "UploadBatch.h"
+
+namespace mcvkp
+{
+    namespace
+    {
+        VkCommandBuffer beginCommandBuffer(VkCommandPool commandPool)
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = commandPool;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(VulkanGlobal::context.getDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate upload command buffer!");
+            }
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            return commandBuffer;
+        }
+    }
+
+    UploadBatch::UploadBatch() : m_dedicatedTransfer(VulkanGlobal::context.hasDedicatedTransferQueue()),
+                                 m_transferSemaphore(VK_NULL_HANDLE), m_submitted(false), m_completed(false), m_bytesStaged(0)
+    {
+        m_transferCommandBuffer = beginCommandBuffer(VulkanGlobal::context.getTransferCommandPool());
+        m_graphicsCommandBuffer = m_transferCommandBuffer;
+
+        if (m_dedicatedTransfer)
+        {
+            m_graphicsCommandBuffer = beginCommandBuffer(VulkanGlobal::context.getCommandPool());
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if (vkCreateSemaphore(VulkanGlobal::context.getDevice(), &semaphoreInfo, nullptr, &m_transferSemaphore) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create upload semaphore!");
+            }
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(VulkanGlobal::context.getDevice(), &fenceInfo, nullptr, &m_fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create upload fence!");
+        }
+    }
+
+    UploadBatch::~UploadBatch()
+    {
+        wait();
+        vkDestroyFence(VulkanGlobal::context.getDevice(), m_fence, nullptr);
+        if (m_transferSemaphore != VK_NULL_HANDLE)
+        {
+            vkDestroySemaphore(VulkanGlobal::context.getDevice(), m_transferSemaphore, nullptr);
+        }
+    }
+
+    VkCommandBuffer UploadBatch::getTransferCommandBuffer() const
+    {
+        return m_transferCommandBuffer;
+    }
+
+    VkCommandBuffer UploadBatch::getGraphicsCommandBuffer() const
+    {
+        return m_graphicsCommandBuffer;
+    }
+
+    std::shared_ptr<Buffer> UploadBatch::stage(const void *data, VkDeviceSize size)
+    {
+        std::shared_ptr<Buffer> stagingBuffer = BufferUtils::acquireStagingBuffer(size);
+        void *mapped;
+        vmaMapMemory(VulkanGlobal::context.getAllocator(), stagingBuffer->allocation, &mapped);
+        memcpy(mapped, data, size);
+        vmaUnmapMemory(VulkanGlobal::context.getAllocator(), stagingBuffer->allocation);
+
+        m_stagingBuffers.push_back(stagingBuffer);
+        m_bytesStaged += size;
+        return stagingBuffer;
+    }
+
+    void UploadBatch::copyToBuffer(Buffer *buffer, VkDeviceSize offset, const void *data, VkDeviceSize size)
+    {
+        std::shared_ptr<Buffer> stagingBuffer = stage(data, size);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = 0;
+        copyRegion.dstOffset = offset;
+        copyRegion.size = size;
+        vkCmdCopyBuffer(m_transferCommandBuffer, stagingBuffer->buffer, buffer->buffer, 1, &copyRegion);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        if (m_dedicatedTransfer)
+        {
+            barrier.srcQueueFamilyIndex = VulkanGlobal::context.getTransferQueueFamily();
+            barrier.dstQueueFamilyIndex = VulkanGlobal::context.getGraphicsQueueFamily();
+        }
+        barrier.buffer = buffer->buffer;
+        barrier.offset = offset;
+        barrier.size = size;
+        m_bufferBarriers.push_back(barrier);
+    }
+
+    void UploadBatch::transferImageOwnership(VkImage image, uint32_t mipLevels)
+    {
+        if (!m_dedicatedTransfer)
+        {
+            return;
+        }
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VulkanGlobal::context.getTransferQueueFamily();
+        barrier.dstQueueFamilyIndex = VulkanGlobal::context.getGraphicsQueueFamily();
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        // Release: the access mask on the receiving side is ignored.
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(m_transferCommandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+
+        // Acquire: the semaphore wait already orders it after the transfer queue's writes.
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(m_graphicsCommandBuffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+    }
+
+    void UploadBatch::submit()
+    {
+        if (m_submitted)
+        {
+            return;
+        }
+
+        // Make the buffer copies visible to whatever reads the geometry later, handing the ranges
+        // over to the graphics family on the way when they were written on the transfer queue.
+        if (!m_bufferBarriers.empty())
+        {
+            if (m_dedicatedTransfer)
+            {
+                for (VkBufferMemoryBarrier &barrier : m_bufferBarriers)
+                {
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                    barrier.dstAccessMask = 0;
+                }
+                vkCmdPipelineBarrier(m_transferCommandBuffer,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                                     0, nullptr,
+                                     static_cast<uint32_t>(m_bufferBarriers.size()), m_bufferBarriers.data(),
+                                     0, nullptr);
+            }
+            for (VkBufferMemoryBarrier &barrier : m_bufferBarriers)
+            {
+                barrier.srcAccessMask = m_dedicatedTransfer ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            }
+            vkCmdPipelineBarrier(m_graphicsCommandBuffer,
+                                 m_dedicatedTransfer ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                                 0, nullptr,
+                                 static_cast<uint32_t>(m_bufferBarriers.size()), m_bufferBarriers.data(),
+                                 0, nullptr);
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+
+        if (m_dedicatedTransfer)
+        {
+            vkEndCommandBuffer(m_transferCommandBuffer);
+            submitInfo.pCommandBuffers = &m_transferCommandBuffer;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &m_transferSemaphore;
+            if (vkQueueSubmit(VulkanGlobal::context.getTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to submit upload command buffer!");
+            }
+
+            VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            submitInfo.signalSemaphoreCount = 0;
+            submitInfo.pSignalSemaphores = nullptr;
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &m_transferSemaphore;
+            submitInfo.pWaitDstStageMask = &waitStage;
+            submitInfo.pCommandBuffers = &m_graphicsCommandBuffer;
+            vkEndCommandBuffer(m_graphicsCommandBuffer);
+            if (vkQueueSubmit(VulkanGlobal::context.getGraphicsQueue(), 1, &submitInfo, m_fence) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to submit upload command buffer!");
+            }
+        }
+        else
+        {
+            vkEndCommandBuffer(m_graphicsCommandBuffer);
+            submitInfo.pCommandBuffers = &m_graphicsCommandBuffer;
+            if (vkQueueSubmit(VulkanGlobal::context.getGraphicsQueue(), 1, &submitInfo, m_fence) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to submit upload command buffer!");
+            }
+        }
+        m_submitted = true;
+    }
+
+    bool UploadBatch::isComplete()
+    {
+        if (m_completed)
+        {
+            return true;
+        }
+        if (!m_submitted || vkGetFenceStatus(VulkanGlobal::context.getDevice(), m_fence) != VK_SUCCESS)
+        {
+            return false;
+        }
+        release();
+        return true;
+    }
+
+    void UploadBatch::wait()
+    {
+        if (m_completed)
+        {
+            return;
+        }
+        submit();
+        vkWaitForFences(VulkanGlobal::context.getDevice(), 1, &m_fence, VK_TRUE, UINT64_MAX);
+        release();
+    }
+
+    VkDeviceSize UploadBatch::getBytesStaged() const
+    {
+        return m_bytesStaged;
+    }
+
+    void UploadBatch::release()
+    {
+        // The graphics submission waited on the transfer one, so the fence covers both.
+        for (const std::shared_ptr<Buffer> &stagingBuffer : m_stagingBuffers)
+        {
+            BufferUtils::releaseStagingBuffer(stagingBuffer);
+        }
+        m_stagingBuffers.clear();
+        vkFreeCommandBuffers(VulkanGlobal::context.getDevice(), VulkanGlobal::context.getTransferCommandPool(), 1, &m_transferCommandBuffer);
+        if (m_dedicatedTransfer)
+        {
+            vkFreeCommandBuffers(VulkanGlobal::context.getDevice(), VulkanGlobal::context.getCommandPool(), 1, &m_graphicsCommandBuffer);
+        }
+        m_completed = true;
+    }
+}
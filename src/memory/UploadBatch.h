@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "Buffer.h"
+
+namespace mcvkp
+{
+    /**
+     * Records the copies, layout transitions and mip blits of many resources and submits them
+     * together with a fence. Staging buffers go back to the pool once the fence has signaled.
+     * Destroying a batch submits it if needed and waits for it.
+     *
+     * Copies run on the transfer queue. With a dedicated transfer family, ownership of every
+     * resource is released there and acquired by the graphics queue, which waits on a semaphore
+     * and runs the graphics-only work (mip blits). Without one both command buffers are the same.
+     */
+    class UploadBatch
+    {
+    public:
+        UploadBatch();
+
+        ~UploadBatch();
+
+        UploadBatch(const UploadBatch &) = delete;
+        UploadBatch &operator=(const UploadBatch &) = delete;
+
+        // Copies and transitions to TRANSFER_DST go here. Only valid until submit().
+        VkCommandBuffer getTransferCommandBuffer() const;
+
+        // Work that needs the graphics queue, recorded after the resource was handed over. Only valid until submit().
+        VkCommandBuffer getGraphicsCommandBuffer() const;
+
+        // Copies data into a staging buffer that stays alive until the batch completes.
+        std::shared_ptr<Buffer> stage(const void *data, VkDeviceSize size);
+
+        // Records a copy of data into a range of a buffer created with TRANSFER_DST usage. The range is
+        // handed to the graphics queue when the batch is submitted.
+        void copyToBuffer(Buffer *buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+
+        // Hands an image written on the transfer command buffer over to the graphics command buffer.
+        // The image stays in TRANSFER_DST_OPTIMAL.
+        void transferImageOwnership(VkImage image, uint32_t mipLevels);
+
+        void submit();
+
+        // Non-blocking. Releases the staging buffers once the GPU is done.
+        bool isComplete();
+
+        // Submits if still recording, then blocks until the GPU is done.
+        void wait();
+
+        VkDeviceSize getBytesStaged() const;
+
+    private:
+        bool m_dedicatedTransfer;
+        VkCommandBuffer m_transferCommandBuffer;
+        VkCommandBuffer m_graphicsCommandBuffer;
+        VkSemaphore m_transferSemaphore;
+        VkFence m_fence;
+        bool m_submitted;
+        bool m_completed;
+        std::vector<std::shared_ptr<Buffer> > m_stagingBuffers;
+        std::vector<VkBufferMemoryBarrier> m_bufferBarriers;
+        VkDeviceSize m_bytesStaged;
+
+        void release();
+    };
+}
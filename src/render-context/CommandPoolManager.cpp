@@ -0,0 +1,68 @@
+#include <stdexcept>
+#include "CommandPoolManager.h"
+#include "../app-context/VulkanApplicationContext.h"
+
+namespace mcvkp
+{
+    CommandPoolManager::CommandPoolManager(size_t numFrames, size_t numThreads, uint32_t queueFamily)
+        : m_numThreads(numThreads), m_pools(numFrames * numThreads)
+    {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamily;
+        // Buffers are short-lived and only ever reset together with their pool.
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        for (Pool &pool : m_pools)
+        {
+            if (vkCreateCommandPool(VulkanGlobal::context.getDevice(), &poolInfo, nullptr, &pool.pool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create command pool!");
+            }
+        }
+    }
+
+    CommandPoolManager::~CommandPoolManager()
+    {
+        // Destroying a pool frees its command buffers.
+        for (Pool &pool : m_pools)
+        {
+            vkDestroyCommandPool(VulkanGlobal::context.getDevice(), pool.pool, nullptr);
+        }
+    }
+
+    void CommandPoolManager::beginFrame(size_t frame)
+    {
+        for (size_t thread = 0; thread < m_numThreads; thread++)
+        {
+            Pool &pool = m_pools[frame * m_numThreads + thread];
+            vkResetCommandPool(VulkanGlobal::context.getDevice(), pool.pool, 0);
+            pool.used[0] = 0;
+            pool.used[1] = 0;
+        }
+    }
+
+    VkCommandBuffer CommandPoolManager::allocate(size_t frame, size_t thread, VkCommandBufferLevel level)
+    {
+        Pool &pool = m_pools[frame * m_numThreads + thread];
+        size_t slot = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1;
+        std::vector<VkCommandBuffer> &commandBuffers = pool.commandBuffers[slot];
+
+        if (pool.used[slot] == commandBuffers.size())
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = pool.pool;
+            allocInfo.level = level;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(VulkanGlobal::context.getDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
+            commandBuffers.push_back(commandBuffer);
+        }
+        return commandBuffers[pool.used[slot]++];
+    }
+}
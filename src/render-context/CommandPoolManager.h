@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include "../utils/vulkan.h"
+
+namespace mcvkp
+{
+    /**
+     * One transient command pool per frame and thread. Command buffers are handed out from a pool
+     * and never freed one by one: beginFrame() resets all of a frame's pools with vkResetCommandPool
+     * and the buffers allocated from them are reused by the next allocations.
+     *
+     * A pool may only be used by one thread at a time, so each thread sticks to its own index.
+     */
+    class CommandPoolManager
+    {
+    public:
+        CommandPoolManager(size_t numFrames, size_t numThreads, uint32_t queueFamily);
+
+        ~CommandPoolManager();
+
+        CommandPoolManager(const CommandPoolManager &) = delete;
+        CommandPoolManager &operator=(const CommandPoolManager &) = delete;
+
+        // Every command buffer of the frame must have finished executing, i.e. its fence has signaled.
+        void beginFrame(size_t frame);
+
+        // Valid until the frame is reset again. Not begun.
+        VkCommandBuffer allocate(size_t frame, size_t thread, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+        size_t getFrameCount() const { return m_pools.size() / m_numThreads; }
+        size_t getThreadCount() const { return m_numThreads; }
+
+    private:
+        struct Pool
+        {
+            VkCommandPool pool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> commandBuffers[2];
+            size_t used[2] = {0, 0};
+        };
+
+        size_t m_numThreads;
+        // Indexed by frame * m_numThreads + thread.
+        std::vector<Pool> m_pools;
+    };
+}
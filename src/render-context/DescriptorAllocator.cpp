@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "DescriptorAllocator.h"
+#include "../app-context/VulkanApplicationContext.h"
+
+namespace mcvkp
+{
+    std::shared_ptr<DescriptorAllocator> DescriptorAllocator::shared()
+    {
+        // Roughly what a material uses: a few uniform buffers and textures per set.
+        static std::shared_ptr<DescriptorAllocator> instance = std::make_shared<DescriptorAllocator>(
+            64, std::vector<PoolSizeRatio>{{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+                                           {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+                                           {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f},
+                                           {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f},
+                                           {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f}});
+        return instance;
+    }
+
+    DescriptorAllocator::DescriptorAllocator(uint32_t initialSetsPerPool, std::vector<PoolSizeRatio> ratios)
+        : m_ratios(std::move(ratios)), m_nextSetsPerPool(std::min(std::max(initialSetsPerPool, 1u), MAX_SETS_PER_POOL)),
+          m_currentPool(NO_POOL)
+    {
+    }
+
+    DescriptorAllocator::~DescriptorAllocator()
+    {
+        for (Pool &pool : m_pools)
+        {
+            vkDestroyDescriptorPool(VulkanGlobal::context.getDevice(), pool.pool, nullptr);
+        }
+    }
+
+    std::vector<VkDescriptorSet> DescriptorAllocator::allocate(VkDescriptorSetLayout layout, uint32_t count)
+    {
+        std::vector<VkDescriptorSetLayout> layouts(count, layout);
+        std::vector<VkDescriptorSet> sets(count);
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorSetCount = count;
+        allocInfo.pSetLayouts = layouts.data();
+
+        bool createPool = false;
+        while (true)
+        {
+            if (m_currentPool == NO_POOL)
+            {
+                __nextPool(createPool);
+            }
+            allocInfo.descriptorPool = m_pools[m_currentPool].pool;
+
+            VkResult result = vkAllocateDescriptorSets(VulkanGlobal::context.getDevice(), &allocInfo, sets.data());
+            if (result == VK_SUCCESS)
+            {
+                m_pools[m_currentPool].liveSets += count;
+                for (VkDescriptorSet set : sets)
+                {
+                    m_setPools[set] = m_currentPool;
+                }
+                return sets;
+            }
+            if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+            {
+                throw std::runtime_error("failed to allocate descriptor sets!");
+            }
+
+            // Full: it goes back to the empty list once its last set is freed.
+            size_t full = m_currentPool;
+            m_currentPool = NO_POOL;
+            if (m_pools[full].liveSets == 0)
+            {
+                // The sets do not even fit an empty pool of this size, only a bigger new one can help.
+                m_emptyPools.push_back(full);
+                if (m_pools[full].maxSets >= MAX_SETS_PER_POOL)
+                {
+                    throw std::runtime_error("failed to allocate descriptor sets: too large for any pool!");
+                }
+                createPool = true;
+            }
+        }
+    }
+
+    void DescriptorAllocator::free(const std::vector<VkDescriptorSet> &sets)
+    {
+        for (VkDescriptorSet set : sets)
+        {
+            auto it = m_setPools.find(set);
+            if (it == m_setPools.end())
+            {
+                continue;
+            }
+            size_t poolIndex = it->second;
+            m_setPools.erase(it);
+
+            Pool &pool = m_pools[poolIndex];
+            if (--pool.liveSets == 0)
+            {
+                vkResetDescriptorPool(VulkanGlobal::context.getDevice(), pool.pool, 0);
+                if (poolIndex != m_currentPool)
+                {
+                    m_emptyPools.push_back(poolIndex);
+                }
+            }
+        }
+    }
+
+    void DescriptorAllocator::reset()
+    {
+        m_emptyPools.clear();
+        for (size_t i = 0; i < m_pools.size(); i++)
+        {
+            vkResetDescriptorPool(VulkanGlobal::context.getDevice(), m_pools[i].pool, 0);
+            m_pools[i].liveSets = 0;
+            if (i != m_currentPool)
+            {
+                m_emptyPools.push_back(i);
+            }
+        }
+        m_setPools.clear();
+    }
+
+    void DescriptorAllocator::__nextPool(bool create)
+    {
+        if (!create && !m_emptyPools.empty())
+        {
+            m_currentPool = m_emptyPools.back();
+            m_emptyPools.pop_back();
+            return;
+        }
+
+        m_pools.push_back({__createPool(m_nextSetsPerPool), m_nextSetsPerPool, 0});
+        m_currentPool = m_pools.size() - 1;
+        m_nextSetsPerPool = std::min(m_nextSetsPerPool * 2, MAX_SETS_PER_POOL);
+    }
+
+    VkDescriptorPool DescriptorAllocator::__createPool(uint32_t maxSets)
+    {
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        for (const PoolSizeRatio &ratio : m_ratios)
+        {
+            VkDescriptorPoolSize size;
+            size.type = ratio.type;
+            size.descriptorCount = std::max(1u, static_cast<uint32_t>(std::ceil(ratio.ratio * maxSets)));
+            poolSizes.push_back(size);
+        }
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = maxSets;
+
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(VulkanGlobal::context.getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        return pool;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "../utils/vulkan.h"
+
+namespace mcvkp
+{
+    /**
+     * Hands out descriptor sets from a list of large pools instead of one exactly sized pool per
+     * owner. When the current pool runs out another one is taken, reusing an empty pool if there
+     * is one and otherwise creating a pool twice the size of the last, up to MAX_SETS_PER_POOL.
+     *
+     * Pools are never freed from set by set. free() only counts the pool's live sets down and
+     * resets the pool once none are left, so persistent sets of owners that come and go return
+     * their memory a pool at a time. For transient sets keep one allocator per frame in flight
+     * and call reset() after that frame's fence has signaled.
+     *
+     * Not thread-safe.
+     */
+    class DescriptorAllocator
+    {
+    public:
+        // Descriptors of a type per set in a pool. A set needing more than this waits for a bigger pool.
+        struct PoolSizeRatio
+        {
+            VkDescriptorType type;
+            float ratio;
+        };
+
+        static const uint32_t MAX_SETS_PER_POOL = 4096;
+
+        // The allocator of materials' descriptor sets.
+        static std::shared_ptr<DescriptorAllocator> shared();
+
+        DescriptorAllocator(uint32_t initialSetsPerPool, std::vector<PoolSizeRatio> ratios);
+
+        // Destroys the pools, which frees every set still allocated from them.
+        ~DescriptorAllocator();
+
+        DescriptorAllocator(const DescriptorAllocator &) = delete;
+        DescriptorAllocator &operator=(const DescriptorAllocator &) = delete;
+
+        // count sets of the layout, all from the same pool.
+        std::vector<VkDescriptorSet> allocate(VkDescriptorSetLayout layout, uint32_t count = 1);
+
+        // The sets must not be in use by the GPU anymore.
+        void free(const std::vector<VkDescriptorSet> &sets);
+
+        // Frees every set. None may be in use by the GPU.
+        void reset();
+
+        size_t getPoolCount() const { return m_pools.size(); }
+        size_t getLiveSetCount() const { return m_setPools.size(); }
+
+    private:
+        struct Pool
+        {
+            VkDescriptorPool pool;
+            uint32_t maxSets;
+            uint32_t liveSets;
+        };
+
+        static const size_t NO_POOL = ~size_t(0);
+
+        // Makes m_currentPool an empty pool, a newly created one if create is set.
+        void __nextPool(bool create);
+        VkDescriptorPool __createPool(uint32_t maxSets);
+
+        std::vector<PoolSizeRatio> m_ratios;
+        uint32_t m_nextSetsPerPool;
+        std::vector<Pool> m_pools;
+        // Indices into m_pools of empty pools other than the current one.
+        std::vector<size_t> m_emptyPools;
+        size_t m_currentPool;
+        // The pool each live set came from.
+        std::unordered_map<VkDescriptorSet, size_t> m_setPools;
+    };
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <stdexcept>
+#include "DescriptorLayoutCache.h"
+#include "../app-context/VulkanApplicationContext.h"
+#include "../utils/Hash.h"
+
+namespace mcvkp
+{
+    std::shared_ptr<DescriptorLayoutCache> DescriptorLayoutCache::shared()
+    {
+        static std::shared_ptr<DescriptorLayoutCache> instance = std::make_shared<DescriptorLayoutCache>();
+        return instance;
+    }
+
+    DescriptorLayoutCache::~DescriptorLayoutCache()
+    {
+        for (auto &bucket : m_layouts)
+        {
+            for (Entry &entry : bucket.second)
+            {
+                vkDestroyDescriptorSetLayout(VulkanGlobal::context.getDevice(), entry.layout, nullptr);
+            }
+        }
+    }
+
+    VkDescriptorSetLayout DescriptorLayoutCache::getLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings)
+    {
+        std::vector<VkDescriptorSetLayoutBinding> sorted = bindings;
+        std::sort(sorted.begin(), sorted.end(), [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b)
+                  { return a.binding < b.binding; });
+
+        std::vector<uint64_t> words;
+        for (const VkDescriptorSetLayoutBinding &binding : sorted)
+        {
+            words.push_back((static_cast<uint64_t>(binding.binding) << 32) | static_cast<uint64_t>(binding.descriptorType));
+            words.push_back((static_cast<uint64_t>(binding.descriptorCount) << 32) | binding.stageFlags);
+            words.push_back(reinterpret_cast<uint64_t>(binding.pImmutableSamplers));
+        }
+        uint64_t hash = Hash::words(words.data(), words.size());
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<Entry> &bucket = m_layouts[hash];
+        for (const Entry &entry : bucket)
+        {
+            if (__equal(entry.bindings, sorted))
+            {
+                return entry.layout;
+            }
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(sorted.size());
+        layoutInfo.pBindings = sorted.data();
+
+        VkDescriptorSetLayout layout;
+        if (vkCreateDescriptorSetLayout(VulkanGlobal::context.getDevice(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+        bucket.push_back({std::move(sorted), layout});
+        m_layoutCount++;
+        return layout;
+    }
+
+    size_t DescriptorLayoutCache::getLayoutCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_layoutCount;
+    }
+
+    bool DescriptorLayoutCache::__equal(const std::vector<VkDescriptorSetLayoutBinding> &a, const std::vector<VkDescriptorSetLayoutBinding> &b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i].binding != b[i].binding || a[i].descriptorType != b[i].descriptorType || a[i].descriptorCount != b[i].descriptorCount ||
+                a[i].stageFlags != b[i].stageFlags || a[i].pImmutableSamplers != b[i].pImmutableSamplers)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
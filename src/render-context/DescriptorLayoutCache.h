@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "../utils/vulkan.h"
+
+namespace mcvkp
+{
+    /**
+     * Deduplicates VkDescriptorSetLayouts: every request with the same bindings, in any order,
+     * gets the same handle. Layouts live as long as the cache, which users keep alive by holding
+     * on to the shared_ptr until their own deleters have run.
+     */
+    class DescriptorLayoutCache
+    {
+    public:
+        // The cache every pipeline template takes its layouts from.
+        static std::shared_ptr<DescriptorLayoutCache> shared();
+
+        DescriptorLayoutCache() = default;
+
+        ~DescriptorLayoutCache();
+
+        DescriptorLayoutCache(const DescriptorLayoutCache &) = delete;
+        DescriptorLayoutCache &operator=(const DescriptorLayoutCache &) = delete;
+
+        // Thread-safe. Owned by the cache, never destroy it.
+        VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+
+        size_t getLayoutCount();
+
+    private:
+        struct Entry
+        {
+            // Sorted by binding number.
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            VkDescriptorSetLayout layout;
+        };
+
+        static bool __equal(const std::vector<VkDescriptorSetLayoutBinding> &a, const std::vector<VkDescriptorSetLayoutBinding> &b);
+
+        std::mutex m_mutex;
+        // Keyed by the hash of the sorted bindings. Collisions share a bucket.
+        std::unordered_map<uint64_t, std::vector<Entry> > m_layouts;
+        size_t m_layoutCount = 0;
+    };
+}
@@ -19,7 +19,7 @@ namespace mcvkp
     }
 
     // This shouldn't be called. Sorry for sloppy OOP.
-    std::shared_ptr<mcvkp::Image> FlatRenderPass::getColorImage()  { return nullptr; }
+    std::shared_ptr<mcvkp::Image> FlatRenderPass::getColorImage(size_t index)  { return nullptr; }
 
     FlatRenderPass::FlatRenderPass()
     {
@@ -16,7 +16,7 @@ class FlatRenderPass : public RenderPass{
         std::shared_ptr<VkFramebuffer> getFramebuffer(size_t index) override;
 
         // This shouldn't be called. Sorry for sloppy OOP.
-        std::shared_ptr<mcvkp::Image> getColorImage() override;
+        std::shared_ptr<mcvkp::Image> getColorImage(size_t index) override;
 
         FlatRenderPass();
 
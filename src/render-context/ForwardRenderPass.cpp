@@ -2,6 +2,7 @@
 #include <vector>
 #include <memory>
 #include <array>
+#include <algorithm>
 #include "../utils/vulkan.h"
 #include "../memory/Image.h"
 #include "ForwardRenderPass.h"
@@ -18,18 +19,21 @@ namespace mcvkp
 
     std::shared_ptr<VkFramebuffer> ForwardRenderPass::getFramebuffer(size_t index) 
     {
-        return m_framebuffer;
+        return m_framebuffers[index % m_framebuffers.size()];
     }
 
-    ForwardRenderPass::ForwardRenderPass()
+    ForwardRenderPass::ForwardRenderPass(size_t numAttachmentSets)
     {
         m_renderPass = std::make_shared<VkRenderPass>();
-        m_colorImage = std::make_shared<mcvkp::Image>();
-        m_depthImage = std::make_shared<mcvkp::Image>();
-        m_framebuffer = std::make_shared<VkFramebuffer>();
+        for (size_t i = 0; i < std::max<size_t>(numAttachmentSets, 1); i++)
+        {
+            m_colorImages.push_back(std::make_shared<mcvkp::Image>());
+            m_depthImages.push_back(std::make_shared<mcvkp::Image>());
+            m_framebuffers.push_back(std::make_shared<VkFramebuffer>());
 
-        createColorResources();
-        createDepthResources();
+            createColorResources(m_colorImages[i]);
+            createDepthResources(m_depthImages[i]);
+        }
         createRenderPass();
         createFramebuffers();
     }
@@ -38,14 +42,22 @@ namespace mcvkp
     {
         std::cout << "Destroying forward pass" << "\n";
 
-        m_colorImage->destroy();
-        m_depthImage->destroy();
-        vkDestroyFramebuffer(VulkanGlobal::context.getDevice(), *m_framebuffer, nullptr);
+        for (size_t i = 0; i < m_framebuffers.size(); i++)
+        {
+            m_colorImages[i]->destroy();
+            m_depthImages[i]->destroy();
+            vkDestroyFramebuffer(VulkanGlobal::context.getDevice(), *m_framebuffers[i], nullptr);
+        }
         vkDestroyRenderPass(VulkanGlobal::context.getDevice(), *m_renderPass, nullptr);
     }
 
-    std::shared_ptr<mcvkp::Image> ForwardRenderPass::getColorImage()  { return m_colorImage; }
-    std::shared_ptr<mcvkp::Image> ForwardRenderPass::getDepthImage() { return m_depthImage; }
+    std::shared_ptr<mcvkp::Image> ForwardRenderPass::getColorImage(size_t index) { return m_colorImages[index % m_colorImages.size()]; }
+    std::shared_ptr<mcvkp::Image> ForwardRenderPass::getDepthImage(size_t index) { return m_depthImages[index % m_depthImages.size()]; }
+
+    size_t ForwardRenderPass::getAttachmentSetCount() const
+    {
+        return m_framebuffers.size();
+    }
 
     void ForwardRenderPass::createRenderPass()
     {
@@ -127,22 +139,25 @@ namespace mcvkp
 
     void ForwardRenderPass::createFramebuffers()
     {
-        std::array<VkImageView, 2> attachments = {
-            m_colorImage->imageView,
-            m_depthImage->imageView};
-
-        VkFramebufferCreateInfo framebufferInfo{};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = *m_renderPass;
-        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        framebufferInfo.pAttachments = attachments.data();
-        framebufferInfo.width = VulkanGlobal::swapchainContext.getExtent().width;
-        framebufferInfo.height = VulkanGlobal::swapchainContext.getExtent().height;
-        framebufferInfo.layers = 1;
-
-        if (vkCreateFramebuffer(VulkanGlobal::context.getDevice(), &framebufferInfo, nullptr, m_framebuffer.get()) != VK_SUCCESS)
+        for (size_t i = 0; i < m_framebuffers.size(); i++)
         {
-            throw std::runtime_error("failed to create framebuffer!");
+            std::array<VkImageView, 2> attachments = {
+                m_colorImages[i]->imageView,
+                m_depthImages[i]->imageView};
+
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = *m_renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = VulkanGlobal::swapchainContext.getExtent().width;
+            framebufferInfo.height = VulkanGlobal::swapchainContext.getExtent().height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(VulkanGlobal::context.getDevice(), &framebufferInfo, nullptr, m_framebuffers[i].get()) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create framebuffer!");
+            }
         }
     }
 
@@ -159,7 +174,7 @@ namespace mcvkp
         return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
     }
 
-    void ForwardRenderPass::createDepthResources()
+    void ForwardRenderPass::createDepthResources(const std::shared_ptr<mcvkp::Image> &depthImage)
     {
         VkFormat depthFormat = findDepthFormat();
         ImageUtils::createImage(VulkanGlobal::swapchainContext.getExtent().width,
@@ -171,10 +186,11 @@ namespace mcvkp
                                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
                                 VK_IMAGE_ASPECT_DEPTH_BIT,
                                 VMA_MEMORY_USAGE_GPU_ONLY,
-                                m_depthImage);
+                                MemoryCategory::eAttachment,
+                                depthImage);
     }
 
-    void ForwardRenderPass::createColorResources()
+    void ForwardRenderPass::createColorResources(const std::shared_ptr<mcvkp::Image> &colorImage)
     {
         VkFormat colorFormat = VulkanGlobal::swapchainContext.getFormat();
 
@@ -187,6 +203,7 @@ namespace mcvkp
                                 VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                                 VK_IMAGE_ASPECT_COLOR_BIT,
                                 VMA_MEMORY_USAGE_GPU_ONLY,
-                                m_colorImage);
+                                MemoryCategory::eAttachment,
+                                colorImage);
     }
 }
@@ -16,18 +16,22 @@ namespace mcvkp
 
         std::shared_ptr<VkFramebuffer> getFramebuffer(size_t index) override;
 
-        ForwardRenderPass();
+        // Each attachment set has its own color image, depth image and framebuffer, so frames that
+        // use different sets do not wait on each other. Index i uses set i % numAttachmentSets.
+        ForwardRenderPass(size_t numAttachmentSets = 1);
 
         ~ForwardRenderPass();
 
-        std::shared_ptr<mcvkp::Image> getColorImage() override ;
-        std::shared_ptr<mcvkp::Image> getDepthImage();
+        std::shared_ptr<mcvkp::Image> getColorImage(size_t index) override ;
+        std::shared_ptr<mcvkp::Image> getDepthImage(size_t index);
+
+        size_t getAttachmentSetCount() const;
 
     private:
-        std::shared_ptr<mcvkp::Image> m_colorImage;
-        std::shared_ptr<mcvkp::Image> m_depthImage;
+        std::vector<std::shared_ptr<mcvkp::Image> > m_colorImages;
+        std::vector<std::shared_ptr<mcvkp::Image> > m_depthImages;
         std::shared_ptr<VkRenderPass> m_renderPass;
-        std::shared_ptr<VkFramebuffer> m_framebuffer;
+        std::vector<std::shared_ptr<VkFramebuffer> > m_framebuffers;
 
         void createRenderPass();
        
@@ -37,8 +41,8 @@ namespace mcvkp
 
         bool hasStencilComponent(VkFormat format);
 
-        void createDepthResources();
+        void createDepthResources(const std::shared_ptr<mcvkp::Image> &depthImage);
 
-        void createColorResources();
+        void createColorResources(const std::shared_ptr<mcvkp::Image> &colorImage);
     };
 }
\ No newline at end of file
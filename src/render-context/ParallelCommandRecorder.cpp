@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <stdexcept>
+#include "ParallelCommandRecorder.h"
+#include "../app-context/VulkanApplicationContext.h"
+#include "../utils/ThreadPool.h"
+
+namespace mcvkp
+{
+    namespace
+    {
+        size_t resolveWorkerCount(size_t numWorkers)
+        {
+            return numWorkers == 0 ? ThreadPool::shared().size() + 1 : numWorkers;
+        }
+    }
+
+    ParallelCommandRecorder::ParallelCommandRecorder(size_t numFrames, size_t numWorkers, size_t minDrawsPerWorker)
+        : m_numWorkers(resolveWorkerCount(numWorkers)),
+          m_minDrawsPerWorker(std::max<size_t>(minDrawsPerWorker, 1)),
+          m_pools(numFrames, m_numWorkers + 1, VulkanGlobal::context.getGraphicsQueueFamily()),
+          m_currentFrame(0)
+    {
+    }
+
+    VkCommandBuffer ParallelCommandRecorder::beginFrame(size_t frame)
+    {
+        m_currentFrame = frame;
+        m_pools.beginFrame(frame);
+        VkCommandBuffer primary = m_pools.allocate(frame, 0);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(primary, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+        return primary;
+    }
+
+    void ParallelCommandRecorder::recordDraws(VkCommandBuffer primary,
+                                              VkRenderPass renderPass,
+                                              VkFramebuffer framebuffer,
+                                              size_t numDraws,
+                                              const RangeFunction &recordRange)
+    {
+        if (numDraws == 0)
+        {
+            return;
+        }
+
+        size_t numRanges = std::min(m_numWorkers, (numDraws + m_minDrawsPerWorker - 1) / m_minDrawsPerWorker);
+        size_t rangeSize = (numDraws + numRanges - 1) / numRanges;
+        numRanges = (numDraws + rangeSize - 1) / rangeSize;
+        std::vector<VkCommandBuffer> secondaries(numRanges);
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = framebuffer;
+
+        // Range i always goes to pool i + 1, whichever thread picks it up.
+        ThreadPool::shared().parallelFor(numRanges, [&](size_t i)
+                                         {
+                                             VkCommandBuffer commandBuffer = m_pools.allocate(m_currentFrame, i + 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+                                             VkCommandBufferBeginInfo beginInfo{};
+                                             beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                                             beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+                                             beginInfo.pInheritanceInfo = &inheritanceInfo;
+                                             if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+                                             {
+                                                 throw std::runtime_error("failed to begin recording command buffer!");
+                                             }
+
+                                             size_t begin = i * rangeSize;
+                                             recordRange(commandBuffer, begin, std::min(begin + rangeSize, numDraws));
+
+                                             if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+                                             {
+                                                 throw std::runtime_error("failed to record command buffer!");
+                                             }
+                                             secondaries[i] = commandBuffer; });
+
+        vkCmdExecuteCommands(primary, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "CommandPoolManager.h"
+
+namespace mcvkp
+{
+    /**
+     * Records a frame's commands from scratch every frame. The primary command buffer comes from
+     * the frame's pool for the calling thread and every worker has its own pool per frame (see
+     * CommandPoolManager), so nothing is freed and no pool is shared between threads.
+     *
+     * Draws inside a render pass are split into contiguous ranges, one per worker, recorded on
+     * ThreadPool::shared() and executed from the primary buffer in order.
+     */
+    class ParallelCommandRecorder
+    {
+    public:
+        // Records the draws [begin, end) into a secondary command buffer.
+        using RangeFunction = std::function<void(VkCommandBuffer &commandBuffer, size_t begin, size_t end)>;
+
+        // numWorkers 0 means one per thread of the shared pool plus the calling thread.
+        // Ranges are never shorter than minDrawsPerWorker, so small scenes do not pay for many buffers.
+        explicit ParallelCommandRecorder(size_t numFrames, size_t numWorkers = 0, size_t minDrawsPerWorker = 16);
+
+        // Resets every pool of the frame and returns a primary command buffer, ready for recording.
+        // Whatever was recorded for the frame before must have finished executing.
+        VkCommandBuffer beginFrame(size_t frame);
+
+        // Call between vkCmdBeginRenderPass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS and
+        // vkCmdEndRenderPass. Returns once every range is recorded and executed into primary.
+        void recordDraws(VkCommandBuffer primary,
+                         VkRenderPass renderPass,
+                         VkFramebuffer framebuffer,
+                         size_t numDraws,
+                         const RangeFunction &recordRange);
+
+        size_t getWorkerCount() const { return m_numWorkers; }
+
+    private:
+        size_t m_numWorkers;
+        size_t m_minDrawsPerWorker;
+        // Thread 0 is the one recording the primary buffer, worker i uses thread i + 1.
+        CommandPoolManager m_pools;
+        size_t m_currentFrame;
+    };
+}
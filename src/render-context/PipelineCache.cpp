@@ -0,0 +1,235 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "../utils/Hash.h"
+#include "../app-context/VulkanApplicationContext.h"
+#include "PipelineCache.h"
+
+namespace mcvkp
+{
+    namespace PipelineCache
+    {
+        namespace
+        {
+            const uint32_t MAGIC = 0x43505643; // "CVPC"
+
+            struct FileHeader
+            {
+                uint32_t magic;
+                uint32_t version;
+                uint32_t vendorID;
+                uint32_t deviceID;
+                uint32_t driverVersion;
+                uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+                uint64_t dataSize;
+                uint64_t dataHash;
+            };
+
+            struct Timing
+            {
+                size_t count = 0;
+                double milliseconds = 0.0;
+            };
+
+            struct Stats
+            {
+                std::mutex mutex;
+                Timing hits;
+                Timing misses;
+                // Created without creation feedback, so it is not known whether the cache was used.
+                Timing unknown;
+            };
+
+            Stats &stats()
+            {
+                // Never destroyed: the context prints the stats from its destructor.
+                static Stats *instance = new Stats();
+                return *instance;
+            }
+
+            FileHeader makeHeader(VkPhysicalDevice physicalDevice)
+            {
+                VkPhysicalDeviceProperties properties;
+                vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+                FileHeader header{};
+                header.magic = MAGIC;
+                header.version = VERSION;
+                header.vendorID = properties.vendorID;
+                header.deviceID = properties.deviceID;
+                header.driverVersion = properties.driverVersion;
+                memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+                return header;
+            }
+
+            // Empty when the file cannot be used; the reason is logged.
+            std::vector<char> readData(VkPhysicalDevice physicalDevice, const std::string &path)
+            {
+                std::ifstream file(path, std::ios::binary | std::ios::ate);
+                if (!file.is_open())
+                {
+                    std::cout << "No pipeline cache at " << path << ", starting cold\n";
+                    return {};
+                }
+                std::streamsize fileSize = file.tellg();
+                file.seekg(0);
+
+                FileHeader header;
+                if (fileSize < static_cast<std::streamsize>(sizeof(header)) ||
+                    !file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+                {
+                    std::cout << "Pipeline cache " << path << " is truncated, ignoring it\n";
+                    return {};
+                }
+
+                FileHeader expected = makeHeader(physicalDevice);
+                if (header.magic != expected.magic || header.version != expected.version)
+                {
+                    std::cout << "Pipeline cache " << path << " has an unknown format, ignoring it\n";
+                    return {};
+                }
+                if (header.vendorID != expected.vendorID || header.deviceID != expected.deviceID ||
+                    header.driverVersion != expected.driverVersion ||
+                    memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+                {
+                    std::cout << "Pipeline cache " << path << " was written by another device or driver, ignoring it\n";
+                    return {};
+                }
+
+                std::vector<char> data(header.dataSize);
+                if (header.dataSize != static_cast<uint64_t>(fileSize) - sizeof(header) ||
+                    !file.read(data.data(), data.size()) ||
+                    Hash::fnv1a(data.data(), data.size()) != header.dataHash)
+                {
+                    std::cout << "Pipeline cache " << path << " is damaged, ignoring it\n";
+                    return {};
+                }
+                return data;
+            }
+        }
+
+        VkPipelineCache create(VkDevice device, VkPhysicalDevice physicalDevice, const std::string &path)
+        {
+            std::vector<char> data = readData(physicalDevice, path);
+
+            VkPipelineCacheCreateInfo cacheInfo{};
+            cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+            cacheInfo.initialDataSize = data.size();
+            cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+            VkPipelineCache cache;
+            if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create pipeline cache!");
+            }
+            if (!data.empty())
+            {
+                std::cout << "Loaded " << data.size() / 1024 << " KiB pipeline cache from " << path << "\n";
+            }
+            return cache;
+        }
+
+        bool save(VkDevice device, VkPhysicalDevice physicalDevice, VkPipelineCache cache, const std::string &path)
+        {
+            size_t dataSize = 0;
+            if (vkGetPipelineCacheData(device, cache, &dataSize, nullptr) != VK_SUCCESS)
+            {
+                return false;
+            }
+            std::vector<char> data(dataSize);
+            if (vkGetPipelineCacheData(device, cache, &dataSize, data.data()) != VK_SUCCESS)
+            {
+                return false;
+            }
+            data.resize(dataSize);
+
+            FileHeader header = makeHeader(physicalDevice);
+            header.dataSize = data.size();
+            header.dataHash = Hash::fnv1a(data.data(), data.size());
+
+            std::string tmpPath = path + ".tmp";
+            {
+                std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+                if (!file.is_open())
+                {
+                    return false;
+                }
+                file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                file.write(data.data(), data.size());
+                if (!file.good())
+                {
+                    file.close();
+                    std::remove(tmpPath.c_str());
+                    return false;
+                }
+            }
+
+            std::error_code error;
+            std::filesystem::rename(tmpPath, path, error);
+            if (error)
+            {
+                std::remove(tmpPath.c_str());
+                return false;
+            }
+
+            std::cout << "Saved " << data.size() / 1024 << " KiB pipeline cache to " << path << "\n";
+            return true;
+        }
+
+        VkResult createGraphicsPipeline(const VkGraphicsPipelineCreateInfo &createInfo, VkPipeline *pipeline)
+        {
+            VkGraphicsPipelineCreateInfo pipelineInfo = createInfo;
+
+            VkPipelineCreationFeedbackEXT pipelineFeedback{};
+            std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks(pipelineInfo.stageCount);
+            VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+            if (VulkanGlobal::context.hasPipelineCreationFeedback())
+            {
+                feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+                feedbackInfo.pNext = pipelineInfo.pNext;
+                feedbackInfo.pPipelineCreationFeedback = &pipelineFeedback;
+                feedbackInfo.pipelineStageCreationFeedbackCount = pipelineInfo.stageCount;
+                feedbackInfo.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+                pipelineInfo.pNext = &feedbackInfo;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            VkResult result = vkCreateGraphicsPipelines(VulkanGlobal::context.getDevice(), VulkanGlobal::context.getPipelineCache(),
+                                                        1, &pipelineInfo, nullptr, pipeline);
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            if (result != VK_SUCCESS)
+            {
+                return result;
+            }
+
+            std::lock_guard<std::mutex> lock(stats().mutex);
+            Timing *timing = &stats().unknown;
+            if (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)
+            {
+                timing = (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) ? &stats().hits
+                                                                                                                        : &stats().misses;
+            }
+            timing->count++;
+            timing->milliseconds += milliseconds;
+            return result;
+        }
+
+        void printStats(std::ostream &out)
+        {
+            std::lock_guard<std::mutex> lock(stats().mutex);
+            out << "Pipeline cache: " << stats().hits.count << " hits (" << stats().hits.milliseconds << " ms), "
+                << stats().misses.count << " misses (" << stats().misses.milliseconds << " ms)";
+            if (stats().unknown.count > 0)
+            {
+                out << ", " << stats().unknown.count << " without feedback (" << stats().unknown.milliseconds << " ms)";
+            }
+            out << "\n";
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include "../utils/vulkan.h"
+
+namespace mcvkp
+{
+    /**
+     * The process-wide VkPipelineCache is owned by VulkanApplicationContext, which loads it at
+     * startup and saves it on shutdown with the functions below. The file starts with the vendor,
+     * device, driver version and pipeline cache UUID it was written with, and is ignored when any
+     * of them differ from the current device, so a driver update never gets stale data.
+     */
+    namespace PipelineCache
+    {
+        // Relative to the working directory, like memory-stats.json.
+        const char *const DEFAULT_PATH = "pipeline-cache.bin";
+
+        // Bump whenever the file layout changes.
+        const uint32_t VERSION = 1;
+
+        // An empty cache when the file is missing, damaged or from another device or driver.
+        VkPipelineCache create(VkDevice device, VkPhysicalDevice physicalDevice, const std::string &path);
+
+        // Writes to a temporary file first, so a crash never leaves a torn cache behind.
+        bool save(VkDevice device, VkPhysicalDevice physicalDevice, VkPipelineCache cache, const std::string &path);
+
+        // vkCreateGraphicsPipelines through the context's cache. Times every creation and, where
+        // VK_EXT_pipeline_creation_feedback is available, tells cache hits from misses.
+        VkResult createGraphicsPipeline(const VkGraphicsPipelineCreateInfo &createInfo, VkPipeline *pipeline);
+
+        void printStats(std::ostream &out);
+    }
+}
@@ -0,0 +1,682 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "RenderGraph.h"
+#include "../app-context/VulkanSwapchain.h"
+#include "../app-context/DeletionQueue.h"
+#include "../memory/MemoryStats.h"
+
+namespace mcvkp
+{
+    GraphRenderPass::GraphRenderPass(VkRenderPass renderPass,
+                                     std::vector<VkFramebuffer> framebuffers,
+                                     std::vector<std::shared_ptr<mcvkp::Image> > colorImages) : m_colorImages(colorImages)
+    {
+        m_renderPass = std::make_shared<VkRenderPass>(renderPass);
+        for (VkFramebuffer framebuffer : framebuffers)
+        {
+            m_framebuffers.push_back(std::make_shared<VkFramebuffer>(framebuffer));
+        }
+    }
+
+    GraphRenderPass::~GraphRenderPass()
+    {
+        for (size_t i = 0; i < m_framebuffers.size(); i++)
+        {
+            vkDestroyFramebuffer(VulkanGlobal::context.getDevice(), *m_framebuffers[i], nullptr);
+        }
+        vkDestroyRenderPass(VulkanGlobal::context.getDevice(), *m_renderPass, nullptr);
+    }
+
+    std::shared_ptr<VkRenderPass> GraphRenderPass::getBody()
+    {
+        return m_renderPass;
+    }
+
+    std::shared_ptr<VkFramebuffer> GraphRenderPass::getFramebuffer(size_t index)
+    {
+        return m_framebuffers[index % m_framebuffers.size()];
+    }
+
+    std::shared_ptr<mcvkp::Image> GraphRenderPass::getColorImage(size_t index)
+    {
+        return m_colorImages.empty() ? nullptr : m_colorImages[index % m_colorImages.size()];
+    }
+
+    RenderGraph::RenderGraph(size_t numInstances) : m_numInstances(std::max<size_t>(numInstances, 1)), m_compiled(false),
+                                                    m_transientBytesWithoutAliasing(0)
+    {
+    }
+
+    RenderGraph::~RenderGraph()
+    {
+        for (Resource &resource : m_resources)
+        {
+            for (const std::shared_ptr<Image> &image : resource.images)
+            {
+                image->destroy();
+            }
+        }
+
+        // Queued after the images, so the memory outlives everything bound to it.
+        for (AliasGroup &group : m_aliasGroups)
+        {
+            for (VmaAllocation allocation : group.allocations)
+            {
+                VulkanGlobal::deletionQueue.push([allocation]()
+                                                 {
+                                                     MemoryStats::untrack(allocation);
+                                                     vmaFreeMemory(VulkanGlobal::context.getAllocator(), allocation); });
+            }
+        }
+    }
+
+    RenderGraph::ResourceHandle RenderGraph::createImage(const std::string &name, VkFormat format, VkImageAspectFlags aspectFlags)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.kind = ResourceKind::eTransientImage;
+        resource.format = format;
+        resource.aspectFlags = aspectFlags;
+        m_resources.push_back(resource);
+        return static_cast<ResourceHandle>(m_resources.size() - 1);
+    }
+
+    RenderGraph::ResourceHandle RenderGraph::importSwapchain()
+    {
+        Resource resource;
+        resource.name = "swapchain";
+        resource.kind = ResourceKind::eSwapchain;
+        resource.format = VulkanGlobal::swapchainContext.getFormat();
+        resource.aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
+        m_resources.push_back(resource);
+        return static_cast<ResourceHandle>(m_resources.size() - 1);
+    }
+
+    RenderGraph::ResourceHandle RenderGraph::importBuffer(const std::string &name, const std::shared_ptr<Buffer> &buffer)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.kind = ResourceKind::eBuffer;
+        resource.buffer = buffer;
+        m_resources.push_back(resource);
+        return static_cast<ResourceHandle>(m_resources.size() - 1);
+    }
+
+    RenderGraph::PassHandle RenderGraph::addPass(const std::string &name, RecordFunction record, VkSubpassContents contents)
+    {
+        if (m_compiled)
+        {
+            throw std::runtime_error("failed to add pass " + name + ": render graph is already compiled!");
+        }
+        Pass pass;
+        pass.name = name;
+        pass.record = record;
+        pass.contents = contents;
+        m_passes.push_back(pass);
+        return static_cast<PassHandle>(m_passes.size() - 1);
+    }
+
+    void RenderGraph::writeColor(PassHandle pass, ResourceHandle image)
+    {
+        addUse(pass, {image, UseType::eColorAttachment, false, {},
+                      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                      VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT});
+    }
+
+    void RenderGraph::writeColor(PassHandle pass, ResourceHandle image, VkClearColorValue clearValue)
+    {
+        VkClearValue clear{};
+        clear.color = clearValue;
+        addUse(pass, {image, UseType::eColorAttachment, true, clear,
+                      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                      VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT});
+    }
+
+    void RenderGraph::writeDepth(PassHandle pass, ResourceHandle image)
+    {
+        addUse(pass, {image, UseType::eDepthAttachment, false, {},
+                      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT});
+    }
+
+    void RenderGraph::writeDepth(PassHandle pass, ResourceHandle image, float clearDepth)
+    {
+        VkClearValue clear{};
+        clear.depthStencil = {clearDepth, 0};
+        addUse(pass, {image, UseType::eDepthAttachment, true, clear,
+                      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT});
+    }
+
+    void RenderGraph::readTexture(PassHandle pass, ResourceHandle image)
+    {
+        addUse(pass, {image, UseType::eSampled, false, {}, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT});
+    }
+
+    void RenderGraph::readBuffer(PassHandle pass, ResourceHandle buffer, VkPipelineStageFlags stages, VkAccessFlags access)
+    {
+        addUse(pass, {buffer, UseType::eBufferRead, false, {}, stages, access});
+    }
+
+    void RenderGraph::writeBuffer(PassHandle pass, ResourceHandle buffer, VkPipelineStageFlags stages, VkAccessFlags access)
+    {
+        addUse(pass, {buffer, UseType::eBufferWrite, false, {}, stages, access});
+    }
+
+    void RenderGraph::addUse(PassHandle pass, const Use &use)
+    {
+        if (m_compiled)
+        {
+            throw std::runtime_error("failed to add use to pass " + m_passes[pass].name + ": render graph is already compiled!");
+        }
+
+        bool isBuffer = use.type == UseType::eBufferRead || use.type == UseType::eBufferWrite;
+        if (isBuffer != (m_resources[use.resource].kind == ResourceKind::eBuffer))
+        {
+            throw std::runtime_error("failed to add use of " + m_resources[use.resource].name + " to pass " + m_passes[pass].name + ": wrong resource type!");
+        }
+
+        switch (use.type)
+        {
+        case UseType::eColorAttachment:
+            m_resources[use.resource].usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            break;
+        case UseType::eDepthAttachment:
+            m_resources[use.resource].usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            break;
+        case UseType::eSampled:
+            m_resources[use.resource].usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+            break;
+        default:
+            break;
+        }
+        m_passes[pass].uses.push_back(use);
+    }
+
+    void RenderGraph::compile()
+    {
+        cullPasses();
+        createTransientImages();
+        for (size_t order = 0; order < m_executionOrder.size(); order++)
+        {
+            Pass &pass = m_passes[m_executionOrder[order]];
+            createRenderPass(pass, order);
+            createBufferBarriers(pass, order);
+        }
+        m_compiled = true;
+
+        std::cout << "Render graph: " << m_executionOrder.size() << " of " << m_passes.size() << " passes run, "
+                  << getTransientBytes() / 1024 << " KiB of transient images ("
+                  << getTransientBytesWithoutAliasing() / 1024 << " KiB without aliasing)\n";
+    }
+
+    void RenderGraph::cullPasses()
+    {
+        // Walk backwards, keeping passes that write something that is presented, imported or read by a kept pass.
+        std::vector<bool> needed(m_resources.size(), false);
+        for (size_t p = m_passes.size(); p-- > 0;)
+        {
+            Pass &pass = m_passes[p];
+            pass.culled = true;
+            for (const Use &use : pass.uses)
+            {
+                bool writes = use.type == UseType::eColorAttachment || use.type == UseType::eDepthAttachment || use.type == UseType::eBufferWrite;
+                if (writes && (m_resources[use.resource].kind != ResourceKind::eTransientImage || needed[use.resource]))
+                {
+                    pass.culled = false;
+                }
+            }
+            if (pass.culled)
+            {
+                continue;
+            }
+
+            // Cleared attachments do not need what was there before. Everything else this pass touches does.
+            for (const Use &use : pass.uses)
+            {
+                needed[use.resource] = !use.clear;
+            }
+        }
+
+        m_executionOrder.clear();
+        for (size_t p = 0; p < m_passes.size(); p++)
+        {
+            if (m_passes[p].culled)
+            {
+                std::cout << "Render graph: culled pass " << m_passes[p].name << "\n";
+                continue;
+            }
+
+            size_t order = m_executionOrder.size();
+            m_executionOrder.push_back(static_cast<PassHandle>(p));
+            for (const Use &use : m_passes[p].uses)
+            {
+                m_resources[use.resource].uses.push_back({order, &use});
+            }
+        }
+
+        for (const Resource &resource : m_resources)
+        {
+            if (resource.kind == ResourceKind::eTransientImage && !resource.uses.empty() &&
+                resource.uses.front().use->type == UseType::eSampled)
+            {
+                throw std::runtime_error("failed to compile render graph: " + resource.name + " is read before it is written!");
+            }
+        }
+    }
+
+    void RenderGraph::createTransientImages()
+    {
+        const VkExtent2D &extent = VulkanGlobal::swapchainContext.getExtent();
+
+        std::vector<ResourceHandle> transients;
+        for (size_t r = 0; r < m_resources.size(); r++)
+        {
+            if (m_resources[r].kind == ResourceKind::eTransientImage && !m_resources[r].uses.empty())
+            {
+                transients.push_back(static_cast<ResourceHandle>(r));
+            }
+        }
+        std::stable_sort(transients.begin(), transients.end(), [this](ResourceHandle a, ResourceHandle b)
+                         { return m_resources[a].uses.front().order < m_resources[b].uses.front().order; });
+
+        for (ResourceHandle r : transients)
+        {
+            Resource &resource = m_resources[r];
+            for (size_t instance = 0; instance < m_numInstances; instance++)
+            {
+                VkImageCreateInfo imageInfo{};
+                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageInfo.extent.width = extent.width;
+                imageInfo.extent.height = extent.height;
+                imageInfo.extent.depth = 1;
+                imageInfo.mipLevels = 1;
+                imageInfo.arrayLayers = 1;
+                imageInfo.format = resource.format;
+                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                imageInfo.usage = resource.usage;
+                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+                // The memory belongs to the alias group, so the image does not free any.
+                std::shared_ptr<Image> image = std::make_shared<Image>();
+                image->image = VK_NULL_HANDLE;
+                image->allocation = VK_NULL_HANDLE;
+                image->imageView = VK_NULL_HANDLE;
+                image->width = extent.width;
+                image->height = extent.height;
+                image->mipLevels = 1;
+                image->format = resource.format;
+                image->usage = resource.usage;
+                image->aspectFlags = resource.aspectFlags;
+                if (vkCreateImage(VulkanGlobal::context.getDevice(), &imageInfo, nullptr, &image->image) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to create render graph image " + resource.name + "!");
+                }
+                resource.images.push_back(image);
+            }
+
+            VkMemoryRequirements requirements;
+            vkGetImageMemoryRequirements(VulkanGlobal::context.getDevice(), resource.images[0]->image, &requirements);
+            m_transientBytesWithoutAliasing += requirements.size * m_numInstances;
+
+            // Reuse the memory of an image whose last use comes before this one's first.
+            size_t firstUse = resource.uses.front().order;
+            size_t lastUse = resource.uses.back().order;
+            bool aliased = false;
+            for (size_t g = 0; g < m_aliasGroups.size() && !aliased; g++)
+            {
+                AliasGroup &group = m_aliasGroups[g];
+                if (group.lastUse < firstUse && (group.requirements.memoryTypeBits & requirements.memoryTypeBits) != 0)
+                {
+                    group.requirements.size = std::max(group.requirements.size, requirements.size);
+                    group.requirements.alignment = std::max(group.requirements.alignment, requirements.alignment);
+                    group.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+                    group.lastUse = lastUse;
+                    group.resources.push_back(r);
+                    resource.aliasGroup = g;
+                    aliased = true;
+                }
+            }
+            if (!aliased)
+            {
+                m_aliasGroups.push_back({requirements, lastUse, {r}, {}});
+                resource.aliasGroup = m_aliasGroups.size() - 1;
+            }
+        }
+
+        for (AliasGroup &group : m_aliasGroups)
+        {
+            for (size_t instance = 0; instance < m_numInstances; instance++)
+            {
+                VmaAllocationCreateInfo allocationInfo{};
+                allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+                VmaAllocation allocation;
+                if (vmaAllocateMemory(VulkanGlobal::context.getAllocator(), &group.requirements, &allocationInfo, &allocation, nullptr) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to allocate render graph memory!");
+                }
+                MemoryStats::track(allocation, MemoryCategory::eAttachment);
+                group.allocations.push_back(allocation);
+
+                for (ResourceHandle r : group.resources)
+                {
+                    std::shared_ptr<Image> &image = m_resources[r].images[instance];
+                    if (vmaBindImageMemory(VulkanGlobal::context.getAllocator(), allocation, image->image) != VK_SUCCESS)
+                    {
+                        throw std::runtime_error("failed to bind render graph image " + m_resources[r].name + "!");
+                    }
+                    image->imageView = ImageUtils::createImageView(image->image, image->format, image->aspectFlags, 1);
+                }
+            }
+        }
+    }
+
+    void RenderGraph::createRenderPass(Pass &pass, size_t order)
+    {
+        std::vector<VkAttachmentDescription> attachments;
+        std::vector<VkAttachmentReference> colorReferences;
+        VkAttachmentReference depthReference{};
+        bool hasDepth = false;
+        std::vector<ResourceHandle> attachmentResources;
+
+        // What has to finish before the pass starts, and what waits for it to finish.
+        VkSubpassDependency incoming{};
+        incoming.srcSubpass = VK_SUBPASS_EXTERNAL;
+        incoming.dstSubpass = 0;
+        VkSubpassDependency outgoing{};
+        outgoing.srcSubpass = 0;
+        outgoing.dstSubpass = VK_SUBPASS_EXTERNAL;
+
+        // The layout an image is left in after use k of it.
+        auto layoutAfter = [this](const Resource &resource, size_t k)
+        {
+            if (k + 1 < resource.uses.size())
+            {
+                return getLayout(resource.uses[k + 1].use->type);
+            }
+            return resource.kind == ResourceKind::eSwapchain ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : getLayout(resource.uses[k].use->type);
+        };
+
+        pass.clearValues.clear();
+        for (const Use &use : pass.uses)
+        {
+            if (use.type != UseType::eColorAttachment && use.type != UseType::eDepthAttachment)
+            {
+                continue;
+            }
+
+            const Resource &resource = m_resources[use.resource];
+            size_t k = 0;
+            while (resource.uses[k].use != &use)
+            {
+                k++;
+            }
+            const UseRef *previous = k > 0 ? &resource.uses[k - 1] : nullptr;
+            const UseRef *next = k + 1 < resource.uses.size() ? &resource.uses[k + 1] : nullptr;
+
+            // Sampled uses do not change the layout, so it is whatever the last attachment use left.
+            VkImageLayout currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            for (size_t j = k; j-- > 0;)
+            {
+                if (resource.uses[j].use->type != UseType::eSampled)
+                {
+                    currentLayout = layoutAfter(resource, j);
+                    break;
+                }
+            }
+
+            VkAttachmentDescription attachment{};
+            attachment.format = resource.format;
+            attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+            attachment.loadOp = use.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : previous != nullptr ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                                                                                : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachment.storeOp = next != nullptr || resource.kind == ResourceKind::eSwapchain ? VK_ATTACHMENT_STORE_OP_STORE
+                                                                                               : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachment.initialLayout = attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? currentLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+            attachment.finalLayout = layoutAfter(resource, k);
+
+            VkAttachmentReference reference{};
+            reference.attachment = static_cast<uint32_t>(attachments.size());
+            reference.layout = getLayout(use.type);
+            if (use.type == UseType::eDepthAttachment)
+            {
+                depthReference = reference;
+                hasDepth = true;
+            }
+            else
+            {
+                colorReferences.push_back(reference);
+            }
+            attachments.push_back(attachment);
+            attachmentResources.push_back(use.resource);
+            pass.clearValues.push_back(use.clearValue);
+
+            incoming.dstStageMask |= use.stages;
+            incoming.dstAccessMask |= use.access;
+            if (previous != nullptr)
+            {
+                incoming.srcStageMask |= previous->use->stages;
+                incoming.srcAccessMask |= previous->use->access;
+            }
+            else if (resource.kind == ResourceKind::eSwapchain)
+            {
+                // The image is acquired with a semaphore waited on at this stage.
+                incoming.srcStageMask |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            }
+            else
+            {
+                // First use this execution: wait for the last use of every image sharing the memory,
+                // from earlier in this execution or from the previous one.
+                for (ResourceHandle alias : m_aliasGroups[resource.aliasGroup].resources)
+                {
+                    incoming.srcStageMask |= m_resources[alias].uses.back().use->stages;
+                    incoming.srcAccessMask |= m_resources[alias].uses.back().use->access;
+                }
+            }
+
+            if (next != nullptr)
+            {
+                outgoing.srcStageMask |= use.stages;
+                outgoing.srcAccessMask |= use.access;
+                outgoing.dstStageMask |= next->use->stages;
+                outgoing.dstAccessMask |= next->use->access;
+            }
+        }
+
+        if (attachments.empty())
+        {
+            return;
+        }
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+        subpass.pColorAttachments = colorReferences.data();
+        subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+        std::vector<VkSubpassDependency> dependencies;
+        dependencies.push_back(incoming);
+        if (outgoing.dstStageMask != 0)
+        {
+            dependencies.push_back(outgoing);
+        }
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
+
+        VkRenderPass renderPass;
+        if (vkCreateRenderPass(VulkanGlobal::context.getDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create render pass " + pass.name + "!");
+        }
+
+        // One framebuffer per swapchain image, using transient copy i % m_numInstances.
+        const VkExtent2D &extent = VulkanGlobal::swapchainContext.getExtent();
+        std::vector<VkFramebuffer> framebuffers(VulkanGlobal::swapchainContext.getImageViews().size());
+        for (size_t i = 0; i < framebuffers.size(); i++)
+        {
+            std::vector<VkImageView> views;
+            for (ResourceHandle r : attachmentResources)
+            {
+                views.push_back(m_resources[r].kind == ResourceKind::eSwapchain ? VulkanGlobal::swapchainContext.getImageViews()[i]
+                                                                                 : m_resources[r].images[i % m_numInstances]->imageView);
+            }
+
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+            framebufferInfo.pAttachments = views.data();
+            framebufferInfo.width = extent.width;
+            framebufferInfo.height = extent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(VulkanGlobal::context.getDevice(), &framebufferInfo, nullptr, &framebuffers[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create framebuffer for " + pass.name + "!");
+            }
+        }
+
+        std::vector<std::shared_ptr<Image> > colorImages;
+        if (!colorReferences.empty())
+        {
+            colorImages = m_resources[attachmentResources[colorReferences[0].attachment]].images;
+        }
+        pass.renderPass = std::make_shared<GraphRenderPass>(renderPass, framebuffers, colorImages);
+    }
+
+    void RenderGraph::createBufferBarriers(Pass &pass, size_t order)
+    {
+        pass.bufferBarriers.clear();
+        for (const Use &use : pass.uses)
+        {
+            if (use.type != UseType::eBufferRead && use.type != UseType::eBufferWrite)
+            {
+                continue;
+            }
+
+            const Resource &resource = m_resources[use.resource];
+            size_t k = 0;
+            while (resource.uses[k].use != &use)
+            {
+                k++;
+            }
+            if (k == 0)
+            {
+                continue;
+            }
+
+            // Reads after reads need nothing.
+            const Use &previous = *resource.uses[k - 1].use;
+            if (previous.type == UseType::eBufferWrite || use.type == UseType::eBufferWrite)
+            {
+                pass.bufferBarriers.push_back({use.resource, previous.stages, previous.access, use.stages, use.access});
+            }
+        }
+    }
+
+    void RenderGraph::execute(VkCommandBuffer &commandBuffer, size_t index)
+    {
+        for (PassHandle p : m_executionOrder)
+        {
+            Pass &pass = m_passes[p];
+
+            if (!pass.bufferBarriers.empty())
+            {
+                std::vector<VkBufferMemoryBarrier> barriers;
+                VkPipelineStageFlags srcStages = 0;
+                VkPipelineStageFlags dstStages = 0;
+                for (const BufferBarrier &bufferBarrier : pass.bufferBarriers)
+                {
+                    VkBufferMemoryBarrier barrier{};
+                    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                    barrier.srcAccessMask = bufferBarrier.srcAccess;
+                    barrier.dstAccessMask = bufferBarrier.dstAccess;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.buffer = m_resources[bufferBarrier.resource].buffer->buffer;
+                    barrier.offset = 0;
+                    barrier.size = VK_WHOLE_SIZE;
+                    barriers.push_back(barrier);
+                    srcStages |= bufferBarrier.srcStages;
+                    dstStages |= bufferBarrier.dstStages;
+                }
+                vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr,
+                                     static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+            }
+
+            if (pass.renderPass == nullptr)
+            {
+                pass.record(commandBuffer, index);
+                continue;
+            }
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = *pass.renderPass->getBody();
+            renderPassInfo.framebuffer = *pass.renderPass->getFramebuffer(index);
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = VulkanGlobal::swapchainContext.getExtent();
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+            renderPassInfo.pClearValues = pass.clearValues.data();
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, pass.contents);
+            pass.record(commandBuffer, index);
+            vkCmdEndRenderPass(commandBuffer);
+        }
+    }
+
+    std::shared_ptr<RenderPass> RenderGraph::getRenderPass(PassHandle pass)
+    {
+        return m_passes[pass].renderPass;
+    }
+
+    std::shared_ptr<Image> RenderGraph::getImage(ResourceHandle image, size_t index)
+    {
+        const std::vector<std::shared_ptr<Image> > &images = m_resources[image].images;
+        return images.empty() ? nullptr : images[index % images.size()];
+    }
+
+    VkDeviceSize RenderGraph::getTransientBytes() const
+    {
+        VkDeviceSize bytes = 0;
+        for (const AliasGroup &group : m_aliasGroups)
+        {
+            bytes += group.requirements.size * group.allocations.size();
+        }
+        return bytes;
+    }
+
+    VkDeviceSize RenderGraph::getTransientBytesWithoutAliasing() const
+    {
+        return m_transientBytesWithoutAliasing;
+    }
+
+    VkImageLayout RenderGraph::getLayout(UseType type)
+    {
+        switch (type)
+        {
+        case UseType::eColorAttachment:
+            return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        case UseType::eDepthAttachment:
+            return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        case UseType::eSampled:
+            return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        default:
+            return VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+    }
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "vk_mem_alloc.h"
+#include "../memory/Buffer.h"
+#include "../memory/Image.h"
+#include "RenderPass.h"
+
+namespace mcvkp
+{
+    // The VkRenderPass and framebuffers the render graph built for one of its passes.
+    class GraphRenderPass : public RenderPass
+    {
+    public:
+        GraphRenderPass(VkRenderPass renderPass,
+                        std::vector<VkFramebuffer> framebuffers,
+                        std::vector<std::shared_ptr<mcvkp::Image> > colorImages);
+
+        ~GraphRenderPass();
+
+        std::shared_ptr<VkRenderPass> getBody() override;
+
+        std::shared_ptr<VkFramebuffer> getFramebuffer(size_t index) override;
+
+        // The first color attachment, nullptr when that is a swapchain image.
+        std::shared_ptr<mcvkp::Image> getColorImage(size_t index) override;
+
+    private:
+        std::shared_ptr<VkRenderPass> m_renderPass;
+        std::vector<std::shared_ptr<VkFramebuffer> > m_framebuffers;
+        std::vector<std::shared_ptr<mcvkp::Image> > m_colorImages;
+    };
+
+    /**
+     * Passes declare the images and buffers they read and write, and compile() derives the rest:
+     * render passes with load/store ops and layouts, the dependencies between passes, and which
+     * passes run at all. A pass none of whose results reach the swapchain or an imported buffer is culled.
+     *
+     * Passes run in the order they were added, so a pass can only read what earlier passes wrote.
+     * Image barriers are folded into the subpass dependencies of the render passes; buffer
+     * barriers are recorded right before the pass that needs them.
+     *
+     * Transient images are created at swapchain size and only live during one execution. Those
+     * whose lifetimes do not overlap share memory. There are numInstances copies of every
+     * transient image; execute(index) uses copy index % numInstances and swapchain image index.
+     */
+    class RenderGraph
+    {
+    public:
+        using ResourceHandle = uint32_t;
+        using PassHandle = uint32_t;
+        // Records the draws of a pass. Runs inside the pass's render pass if it has attachments.
+        using RecordFunction = std::function<void(VkCommandBuffer &commandBuffer, size_t index)>;
+
+        explicit RenderGraph(size_t numInstances = 1);
+
+        ~RenderGraph();
+
+        RenderGraph(const RenderGraph &) = delete;
+        RenderGraph &operator=(const RenderGraph &) = delete;
+
+        ResourceHandle createImage(const std::string &name, VkFormat format, VkImageAspectFlags aspectFlags);
+
+        // The image acquired for the frame. Left in PRESENT_SRC_KHR layout.
+        ResourceHandle importSwapchain();
+
+        // Synchronizing the buffer with work outside the graph is up to the caller.
+        ResourceHandle importBuffer(const std::string &name, const std::shared_ptr<Buffer> &buffer);
+
+        // With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS record may only execute secondary command buffers.
+        PassHandle addPass(const std::string &name, RecordFunction record, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+
+        // Without a clear value the previous contents are loaded, if there are any.
+        void writeColor(PassHandle pass, ResourceHandle image);
+        void writeColor(PassHandle pass, ResourceHandle image, VkClearColorValue clearValue);
+
+        void writeDepth(PassHandle pass, ResourceHandle image);
+        void writeDepth(PassHandle pass, ResourceHandle image, float clearDepth);
+
+        // Sampled from fragment shaders.
+        void readTexture(PassHandle pass, ResourceHandle image);
+
+        void readBuffer(PassHandle pass, ResourceHandle buffer, VkPipelineStageFlags stages, VkAccessFlags access);
+        void writeBuffer(PassHandle pass, ResourceHandle buffer, VkPipelineStageFlags stages, VkAccessFlags access);
+
+        // Creates the transient images, their memory, render passes and framebuffers. Declare everything first.
+        void compile();
+
+        // Records every pass that survived culling.
+        void execute(VkCommandBuffer &commandBuffer, size_t index);
+
+        // nullptr for passes without attachments or culled passes.
+        std::shared_ptr<RenderPass> getRenderPass(PassHandle pass);
+
+        std::shared_ptr<Image> getImage(ResourceHandle image, size_t index);
+
+        // Memory bound to transient images, with aliasing and as it would be without.
+        VkDeviceSize getTransientBytes() const;
+        VkDeviceSize getTransientBytesWithoutAliasing() const;
+
+    private:
+        enum class UseType
+        {
+            eColorAttachment,
+            eDepthAttachment,
+            eSampled,
+            eBufferRead,
+            eBufferWrite
+        };
+
+        enum class ResourceKind
+        {
+            eTransientImage,
+            eSwapchain,
+            eBuffer
+        };
+
+        struct Use
+        {
+            ResourceHandle resource;
+            UseType type;
+            bool clear;
+            VkClearValue clearValue;
+            VkPipelineStageFlags stages;
+            VkAccessFlags access;
+        };
+
+        struct BufferBarrier
+        {
+            ResourceHandle resource;
+            VkPipelineStageFlags srcStages;
+            VkAccessFlags srcAccess;
+            VkPipelineStageFlags dstStages;
+            VkAccessFlags dstAccess;
+        };
+
+        struct Pass
+        {
+            std::string name;
+            RecordFunction record;
+            VkSubpassContents contents;
+            std::vector<Use> uses;
+            bool culled = false;
+            std::shared_ptr<GraphRenderPass> renderPass;
+            std::vector<VkClearValue> clearValues;
+            std::vector<BufferBarrier> bufferBarriers;
+        };
+
+        // A position in the execution order and the use of the resource there.
+        struct UseRef
+        {
+            size_t order;
+            const Use *use;
+        };
+
+        struct Resource
+        {
+            std::string name;
+            ResourceKind kind;
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            VkImageAspectFlags aspectFlags = 0;
+            VkImageUsageFlags usage = 0;
+            std::vector<std::shared_ptr<Image> > images;
+            std::shared_ptr<Buffer> buffer;
+            std::vector<UseRef> uses;
+            size_t aliasGroup = 0;
+        };
+
+        struct AliasGroup
+        {
+            VkMemoryRequirements requirements;
+            size_t lastUse;
+            std::vector<ResourceHandle> resources;
+            std::vector<VmaAllocation> allocations;
+        };
+
+        void addUse(PassHandle pass, const Use &use);
+        void cullPasses();
+        void createTransientImages();
+        void createRenderPass(Pass &pass, size_t order);
+        void createBufferBarriers(Pass &pass, size_t order);
+
+        static VkImageLayout getLayout(UseType type);
+
+        size_t m_numInstances;
+        bool m_compiled;
+        std::vector<Resource> m_resources;
+        std::vector<Pass> m_passes;
+        // Indices into m_passes of the passes that run, in order.
+        std::vector<PassHandle> m_executionOrder;
+        std::vector<AliasGroup> m_aliasGroups;
+        VkDeviceSize m_transientBytesWithoutAliasing;
+    };
+}
@@ -9,6 +9,6 @@ class RenderPass {
     public:
         virtual std::shared_ptr<VkRenderPass> getBody() = 0;
         virtual std::shared_ptr<VkFramebuffer> getFramebuffer(size_t index) = 0;
-        virtual std::shared_ptr<mcvkp::Image> getColorImage() = 0;
+        virtual std::shared_ptr<mcvkp::Image> getColorImage(size_t index) = 0;
 };
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "../scene/Scene.h"
 #include "../utils/vulkan.h"
 #include "../app-context/VulkanApplicationContext.h"
+#include "CommandPoolManager.h"
 #include <memory>
 #include <vector>
 
@@ -9,6 +10,16 @@ namespace mcvkp
 {
     namespace RenderSystem
     {
+        namespace
+        {
+            // One-shot commands are waited on before returning, so their pool is simply reset on the next use.
+            CommandPoolManager &singleTimePool()
+            {
+                static CommandPoolManager pool(1, 1, VulkanGlobal::context.getGraphicsQueueFamily());
+                return pool;
+            }
+        }
+
         void allocateCommandBuffers(std::vector<VkCommandBuffer> &commandBuffers, uint32_t numBuffers)
         {
             commandBuffers.resize(numBuffers);
@@ -47,14 +58,8 @@ namespace mcvkp
 
         VkCommandBuffer beginSingleTimeCommands()
         {
-            VkCommandBufferAllocateInfo allocInfo{};
-            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-            allocInfo.commandPool = VulkanGlobal::context.getCommandPool();
-            allocInfo.commandBufferCount = 1;
-
-            VkCommandBuffer commandBuffer;
-            vkAllocateCommandBuffers(VulkanGlobal::context.getDevice(), &allocInfo, &commandBuffer);
+            singleTimePool().beginFrame(0);
+            VkCommandBuffer commandBuffer = singleTimePool().allocate(0, 0);
 
             VkCommandBufferBeginInfo beginInfo{};
             beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -76,8 +81,6 @@ namespace mcvkp
 
             vkQueueSubmit(VulkanGlobal::context.getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
             vkQueueWaitIdle(VulkanGlobal::context.getGraphicsQueue());
-
-            vkFreeCommandBuffers(VulkanGlobal::context.getDevice(), VulkanGlobal::context.getCommandPool(), 1, &commandBuffer);
         }
 
         void submit(
@@ -15,6 +15,7 @@ namespace mcvkp
 
         void endCommandBuffer(const VkCommandBuffer &commandBuffer);
 
+        // Not thread-safe: every one-shot command buffer comes from the same pool.
         VkCommandBuffer beginSingleTimeCommands();
 
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
@@ -1,29 +1,77 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include "../utils/vulkan.h"
+#include <chrono>
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "VertexQuantizer.h"
 #include "../memory/Buffer.h"
+#include "../app-context/DeletionQueue.h"
 #include "Material.h"
 #include "DrawableModel.h"
 
 namespace mcvkp {
 DrawableModel::DrawableModel(std::shared_ptr<Material> material,
-                             std::string modelPath) : m_material(material)
+                             std::string modelPath,
+                             const MeshImportOptions &options,
+                             UploadBatch *uploadBatch) : m_material(material), m_vertexFormat(options.vertexFormat), m_pushConstants{},
+                                                         m_modelMatrix(1.0f), m_lodErrorThreshold(1.0f), m_currentLod(0), m_numDrawCommands(0)
 {
-    Mesh m(modelPath);
+    if (m_vertexFormat != m_material->getVertexFormat())
+    {
+        throw std::runtime_error("vertex format of " + modelPath + " does not match its material!");
+    }
 
-    initVertexBuffer(m);
-    initIndexBuffer(m);
+    if (options.useCache)
+    {
+        // Upload straight from the mapped cache file, no intermediate Mesh.
+        MeshCache::Entry cached;
+        if (MeshCache::load(modelPath, options, cached))
+        {
+            initVertexBuffer(cached.vertices(), cached.vertexCount(), uploadBatch);
+            initIndexBuffer(cached.indices(), cached.indexCount(), cached.vertexCount(), uploadBatch);
+            initDrawCommands(cached.meshlets(), cached.meshletCount(), cached.lods(), cached.lodCount());
+            return;
+        }
+    }
+
+    auto importStart = std::chrono::high_resolution_clock::now();
+    Mesh m(modelPath, options);
+    auto importEnd = std::chrono::high_resolution_clock::now();
+
+    if (options.useCache)
+    {
+        MeshCache::store(modelPath, options, m, std::chrono::duration<double, std::milli>(importEnd - importStart).count());
+    }
+
+    initVertexBuffer(m.vertices.data(), m.vertices.size(), uploadBatch);
+    initIndexBuffer(m.indices.data(), m.indices.size(), m.vertices.size(), uploadBatch);
+    initDrawCommands(m.meshlets.data(), m.meshlets.size(), m.lods.data(), m.lods.size());
 }
 
 DrawableModel::DrawableModel(std::shared_ptr<Material> material,
-                             MeshType type) : m_material(material)
+                             MeshType type,
+                             UploadBatch *uploadBatch) : m_material(material), m_vertexFormat(m_material->getVertexFormat()), m_pushConstants{},
+                                                         m_modelMatrix(1.0f), m_lodErrorThreshold(1.0f), m_currentLod(0), m_numDrawCommands(0)
 {
     Mesh m(type);
 
-    initVertexBuffer(m);
-    initIndexBuffer(m);
+    initVertexBuffer(m.vertices.data(), m.vertices.size(), uploadBatch);
+    initIndexBuffer(m.indices.data(), m.indices.size(), m.vertices.size(), uploadBatch);
+    initDrawCommands(nullptr, 0, nullptr, 0);
+}
+
+DrawableModel::~DrawableModel()
+{
+    // Frames in flight may still read the ranges, so they only go back to the arena once those are done.
+    GeometryArena::Allocation vertexAllocation = m_vertexAllocation;
+    GeometryArena::Allocation indexAllocation = m_indexAllocation;
+    VulkanGlobal::deletionQueue.push([vertexAllocation, indexAllocation]()
+                                     {
+                                         GeometryArena::get().free(vertexAllocation);
+                                         GeometryArena::get().free(indexAllocation); });
 }
 
 std::shared_ptr<Material> DrawableModel::getMaterial()
@@ -31,41 +79,209 @@ std::shared_ptr<Material> DrawableModel::getMaterial()
     return m_material;
 }
 
-void DrawableModel::drawCommand(VkCommandBuffer &commandBuffer, size_t currentFrame)
+void DrawableModel::drawCommand(VkCommandBuffer &commandBuffer, size_t currentFrame, BindState &bindState)
 {
-    // mcvkp::Buffer<VkDrawIndexedIndirectCommand> indirectBuffer;
-    // VkDrawIndexedIndirectCommand indirectCommand;
-    // indirectCommand.indexCount = static_cast<uint32_t>(mesh.indices.size());
-    // indirectCommand.instanceCount = 1;
-    // indirectCommand.firstIndex = 0;
-    // indirectCommand.vertexOffset = 0;
-    // indirectCommand.firstInstance = 0;
+    // Culled entirely this frame.
+    if (m_drawCommandBundle != nullptr && m_numDrawCommands == 0)
+    {
+        return;
+    }
+
+    m_material->bind(commandBuffer, currentFrame, bindState.material);
+    GeometryArena::get().bind(commandBuffer, m_vertexAllocation, m_indexAllocation, bindState.geometry);
 
-    // indirectBuffer.create(&indirectCommand, sizeof(VkDrawIndirectCommand), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    vkCmdPushConstants(commandBuffer, m_material->getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT,
+                       0, sizeof(DrawPushConstants), &m_pushConstants);
 
-    m_material->bind(commandBuffer, currentFrame);
-    VkBuffer vertexBuffers[] = {m_vertexBuffer.buffer};
-    VkDeviceSize offsets[] = {0};
+    if (m_drawCommandBundle == nullptr)
+    {
+        vkCmdDrawIndexed(commandBuffer, m_lods[0].indexCount, 1, m_indexAllocation.firstElement(),
+                         static_cast<int32_t>(m_vertexAllocation.firstElement()), 0);
+        return;
+    }
 
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+    // Command buffers are recorded right after updateDrawCommands, so only the written slots are drawn.
+    VkBuffer indirectBuffer = m_drawCommandBundle->buffers[currentFrame]->buffer;
+    uint32_t numSlots = m_numDrawCommands;
+    uint32_t drawStride = sizeof(VkDrawIndexedIndirectCommand);
+    uint32_t maxDrawCount = VulkanGlobal::context.getMaxDrawIndirectCount();
+    for (uint32_t first = 0; first < numSlots; first += maxDrawCount)
+    {
+        uint32_t drawCount = std::min(maxDrawCount, numSlots - first);
+        vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, first * drawStride, drawCount, drawStride);
+    }
+}
 
-    VkDeviceSize indirect_offset = 0;
-    uint32_t draw_stride = sizeof(VkDrawIndirectCommand);
+void DrawableModel::setModelMatrix(const glm::mat4 &modelMatrix)
+{
+    m_modelMatrix = modelMatrix;
+}
 
-    // execute the draw command buffer on each section as defined by the array of draws
-    // vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer.buffer, indirect_offset, 1, draw_stride);
-    vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_numIndices), 1, 0, 0, 0);
+void DrawableModel::setObjectId(uint32_t objectId)
+{
+    m_pushConstants.objectId = objectId;
 }
 
-void DrawableModel::initVertexBuffer(const Mesh &mesh)
+void DrawableModel::setLodErrorThreshold(float pixels)
 {
-    BufferUtils::create<Vertex>(&m_vertexBuffer, mesh.vertices.data(), mesh.vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    m_lodErrorThreshold = pixels;
 }
 
-void DrawableModel::initIndexBuffer(const Mesh &mesh)
+void DrawableModel::updateDrawCommands(const Frustum &frustum, const glm::vec3 &cameraPosition, float projectionScale, size_t currentFrame)
 {
-    m_numIndices = mesh.indices.size();
-    BufferUtils::create<uint32_t>(&m_indexBuffer, mesh.indices.data(), mesh.indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    if (m_drawCommandBundle == nullptr)
+    {
+        return;
+    }
+
+    glm::mat3 linear(m_modelMatrix);
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+    float scale = std::max(glm::length(linear[0]), std::max(glm::length(linear[1]), glm::length(linear[2])));
+
+    size_t numCommands = 0;
+    m_visibleIndexCount = 0;
+    uint32_t firstIndex = m_indexAllocation.firstElement();
+    int32_t vertexOffset = static_cast<int32_t>(m_vertexAllocation.firstElement());
+
+    glm::vec3 boundsCenter = glm::vec3(m_modelMatrix * glm::vec4(m_boundsCenter, 1.0f));
+    float boundsRadius = m_boundsRadius * scale;
+    if (frustum.intersectsSphere(boundsCenter, boundsRadius))
+    {
+        // Coarsest level whose error, seen from the nearest point of the bounds, stays under the threshold.
+        float distance = std::max(glm::length(boundsCenter - cameraPosition) - boundsRadius, 1e-3f);
+        m_currentLod = 0;
+        while (m_currentLod + 1 < m_lods.size() &&
+               m_lods[m_currentLod + 1].error * scale * projectionScale / distance <= m_lodErrorThreshold)
+        {
+            m_currentLod++;
+        }
+
+        if (m_currentLod > 0 || m_meshlets.empty())
+        {
+            const MeshLod &lod = m_lods[m_currentLod];
+            m_drawCommands[numCommands++] = {lod.indexCount, 1, firstIndex + lod.firstIndex, vertexOffset, 0};
+            m_visibleIndexCount = lod.indexCount;
+        }
+        else
+        {
+            for (const Meshlet &meshlet : m_meshlets)
+            {
+                glm::vec3 center = glm::vec3(m_modelMatrix * glm::vec4(meshlet.center, 1.0f));
+                float radius = meshlet.radius * scale;
+                if (!frustum.intersectsSphere(center, radius))
+                {
+                    continue;
+                }
+
+                if (meshlet.coneCutoff < 1.0f)
+                {
+                    glm::vec3 axis = glm::normalize(normalMatrix * meshlet.coneAxis);
+                    glm::vec3 toCenter = center - cameraPosition;
+                    if (glm::dot(toCenter, axis) >= meshlet.coneCutoff * glm::length(toCenter) + radius)
+                    {
+                        continue;
+                    }
+                }
+
+                // Meshlets are stored back to back, so neighbouring visible ones merge into one range.
+                VkDrawIndexedIndirectCommand *last = numCommands > 0 ? &m_drawCommands[numCommands - 1] : nullptr;
+                if (last != nullptr && last->firstIndex + last->indexCount == firstIndex + meshlet.firstIndex)
+                {
+                    last->indexCount += meshlet.indexCount;
+                }
+                else
+                {
+                    m_drawCommands[numCommands++] = {meshlet.indexCount, 1, firstIndex + meshlet.firstIndex, vertexOffset, 0};
+                }
+                m_visibleIndexCount += meshlet.indexCount;
+            }
+        }
+    }
+    std::fill(m_drawCommands.begin() + numCommands, m_drawCommands.end(), VkDrawIndexedIndirectCommand{});
+    m_numDrawCommands = static_cast<uint32_t>(numCommands);
+
+    Buffer &buffer = *m_drawCommandBundle->buffers[currentFrame];
+    void *data;
+    vmaMapMemory(VulkanGlobal::context.getAllocator(), buffer.allocation, &data);
+    memcpy(data, m_drawCommands.data(), m_drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand));
+    vmaUnmapMemory(VulkanGlobal::context.getAllocator(), buffer.allocation);
+}
+
+uint32_t DrawableModel::getIndexCount() const
+{
+    return m_lods[0].indexCount;
+}
+
+uint32_t DrawableModel::getVisibleIndexCount() const
+{
+    return m_visibleIndexCount;
+}
+
+uint32_t DrawableModel::getCurrentLod() const
+{
+    return m_currentLod;
+}
+
+void DrawableModel::initVertexBuffer(const Vertex *vertices, size_t numVertices, UploadBatch *uploadBatch)
+{
+    glm::vec3 boundsMin(0.0f);
+    glm::vec3 boundsMax(0.0f);
+    for (size_t i = 0; i < numVertices; i++)
+    {
+        boundsMin = i == 0 ? vertices[i].pos : glm::min(boundsMin, vertices[i].pos);
+        boundsMax = i == 0 ? vertices[i].pos : glm::max(boundsMax, vertices[i].pos);
+    }
+    m_boundsCenter = (boundsMin + boundsMax) * 0.5f;
+    m_boundsRadius = 0.0f;
+    for (size_t i = 0; i < numVertices; i++)
+    {
+        m_boundsRadius = std::max(m_boundsRadius, glm::length(vertices[i].pos - m_boundsCenter));
+    }
+
+    if (m_vertexFormat == VertexFormat::eCompact)
+    {
+        std::vector<CompactVertex> compactVertices;
+        VertexQuantizer::quantize(vertices, numVertices, compactVertices, m_pushConstants.dequantization);
+        m_vertexAllocation = GeometryArena::get().allocateVertices(compactVertices.data(), compactVertices.size(), sizeof(CompactVertex), uploadBatch);
+        return;
+    }
+    m_vertexAllocation = GeometryArena::get().allocateVertices(vertices, numVertices, sizeof(Vertex), uploadBatch);
+}
+
+void DrawableModel::initIndexBuffer(const uint32_t *indices, size_t numIndices, size_t numVertices, UploadBatch *uploadBatch)
+{
+    m_numIndices = numIndices;
+    if (numVertices <= 0xffff)
+    {
+        // Indices are relative to the model's vertexOffset, so 16 bits are enough even deep into the arena.
+        std::vector<uint16_t> shortIndices(indices, indices + numIndices);
+        m_indexAllocation = GeometryArena::get().allocateIndices(shortIndices.data(), numIndices, VK_INDEX_TYPE_UINT16, uploadBatch);
+        return;
+    }
+    m_indexAllocation = GeometryArena::get().allocateIndices(indices, numIndices, VK_INDEX_TYPE_UINT32, uploadBatch);
+}
+
+void DrawableModel::initDrawCommands(const Meshlet *meshlets, size_t numMeshlets, const MeshLod *lods, size_t numLods)
+{
+    m_meshlets.assign(meshlets, meshlets + numMeshlets);
+    m_lods.assign(lods, lods + numLods);
+    if (m_lods.empty())
+    {
+        m_lods.push_back({0, m_numIndices, 0.0f});
+    }
+    m_visibleIndexCount = m_lods[0].indexCount;
+    if (m_meshlets.empty() && m_lods.size() == 1)
+    {
+        return;
+    }
+
+    // Until the first update every frame draws the full detail level as one range.
+    m_drawCommands.assign(std::max<size_t>(numMeshlets, 1), VkDrawIndexedIndirectCommand{});
+    m_drawCommands[0] = {m_lods[0].indexCount, 1, m_indexAllocation.firstElement(), static_cast<int32_t>(m_vertexAllocation.firstElement()), 0};
+    m_numDrawCommands = 1;
+
+    m_drawCommandBundle = std::make_shared<BufferBundle>(VulkanGlobal::swapchainContext.getImages().size());
+    BufferUtils::createBundle<VkDrawIndexedIndirectCommand>(m_drawCommandBundle.get(), m_drawCommands.data(), m_drawCommands.size(),
+                                                            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
 }
 }
\ No newline at end of file
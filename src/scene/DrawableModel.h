@@ -4,6 +4,9 @@
 #include "../utils/vulkan.h"
 #include "Mesh.h"
 #include "../memory/Buffer.h"
+#include "../memory/GeometryArena.h"
+#include "../memory/UploadBatch.h"
+#include "../utils/Frustum.h"
 #include "Material.h"
 
 namespace mcvkp
@@ -12,23 +15,84 @@ namespace mcvkp
     class DrawableModel
     {
     public:
+        // What the previous draw in a command buffer left bound.
+        struct BindState
+        {
+            Material::BindState material;
+            GeometryArena::BindState geometry;
+        };
+
+        // With an upload batch the geometry is only usable once the batch completes.
         DrawableModel(std::shared_ptr<Material> material,
-                      std::string modelPath);
+                      std::string modelPath,
+                      const MeshImportOptions &options = MeshImportOptions(),
+                      UploadBatch *uploadBatch = nullptr);
 
         DrawableModel(std::shared_ptr<Material> material,
-                      MeshType type);
+                      MeshType type,
+                      UploadBatch *uploadBatch = nullptr);
+
+        ~DrawableModel();
 
         std::shared_ptr<Material> getMaterial();
-        void drawCommand(VkCommandBuffer &commandBuffer, size_t currentFrame);
+
+        // Geometry lives in the shared GeometryArena and pipelines in shared templates; bindState
+        // skips rebinding either when the previous model used the same.
+        void drawCommand(VkCommandBuffer &commandBuffer, size_t currentFrame, BindState &bindState);
+
+        // Transform used for culling and LOD selection. Should match the model matrix the material's shader uses.
+        void setModelMatrix(const glm::mat4 &modelMatrix);
+
+        // Index of the model's transform in the ObjectStore bound with its material's globals. Pushed with every draw.
+        void setObjectId(uint32_t objectId);
+
+        // Largest simplification error, in pixels, a level of detail may show on screen. Defaults to 1.
+        void setLodErrorThreshold(float pixels);
+
+        /**
+         * Picks the coarsest level of detail whose error projects below the threshold, culls the
+         * meshlets of the full detail level against the frustum and their normal cones, and writes the
+         * index ranges to draw to the indirect buffer of the given frame. projectionScale converts
+         * view-space size at distance 1 to pixels: viewport height / (2 tan(fovy / 2)).
+         * Models without meshlets or LODs are always drawn whole.
+         */
+        void updateDrawCommands(const Frustum &frustum, const glm::vec3 &cameraPosition, float projectionScale, size_t currentFrame);
+
+        // Indices of the full detail level.
+        uint32_t getIndexCount() const;
+        // Indices drawn by the last updateDrawCommands.
+        uint32_t getVisibleIndexCount() const;
+        // Level of detail chosen by the last updateDrawCommands, 0 is full detail.
+        uint32_t getCurrentLod() const;
 
     private:
         std::shared_ptr<Material> m_material;
-        mcvkp::Buffer m_vertexBuffer;
-        mcvkp::Buffer m_indexBuffer;
+        GeometryArena::Allocation m_vertexAllocation;
+        GeometryArena::Allocation m_indexAllocation;
         uint32_t m_numIndices;
+        VertexFormat m_vertexFormat;
+        DrawPushConstants m_pushConstants;
+
+        std::vector<Meshlet> m_meshlets;
+        // All levels live in the one index buffer. Level 0 is full detail.
+        std::vector<MeshLod> m_lods;
+        glm::vec3 m_boundsCenter;
+        float m_boundsRadius;
+        glm::mat4 m_modelMatrix;
+        float m_lodErrorThreshold;
+        uint32_t m_currentLod;
+        uint32_t m_visibleIndexCount;
+        // One indirect buffer per swapchain image with one command slot per meshlet (at least one).
+        std::shared_ptr<BufferBundle> m_drawCommandBundle;
+        std::vector<VkDrawIndexedIndirectCommand> m_drawCommands;
+        // Slots written by the last updateDrawCommands. Only valid for the frame it was called with.
+        uint32_t m_numDrawCommands;
+
+        void initVertexBuffer(const Vertex *vertices, size_t numVertices, UploadBatch *uploadBatch);
 
-        void initVertexBuffer(const Mesh &mesh);
+        // Uses 16-bit indices when every index fits.
+        void initIndexBuffer(const uint32_t *indices, size_t numIndices, size_t numVertices, UploadBatch *uploadBatch);
 
-        void initIndexBuffer(const Mesh &mesh);
+        void initDrawCommands(const Meshlet *meshlets, size_t numMeshlets, const MeshLod *lods, size_t numLods);
     };
 }
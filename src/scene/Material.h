@@ -4,23 +4,42 @@
 #include "../memory/Buffer.h"
 #include "../utils/vulkan.h"
 #include "../memory/Image.h"
+#include "../memory/UniformRingBuffer.h"
 #include "../app-context/VulkanSwapchain.h"
+#include "Mesh.h"
+#include "PipelineTemplate.h"
+#include "ResourceBindings.h"
 
 namespace mcvkp
 {
-    template <typename T>
-    struct Descriptor
-    {
-        std::shared_ptr<T> data;
-        VkShaderStageFlags shaderStageFlags;
-    };
-
+    // Descriptor set numbers, by how often what they hold changes. Per-draw data is pushed as constants.
+    const uint32_t GLOBAL_DESCRIPTOR_SET = 0;
+    const uint32_t MATERIAL_DESCRIPTOR_SET = 1;
+
+    /**
+     * The descriptor bindings of one object or group of objects. The shaders and fixed-function
+     * state live in a PipelineTemplate that every material with the same description shares.
+     *
+     * Resources added to the material itself go in set 1. Set 0 holds per-frame globals, such as
+     * the camera uniforms and object transforms, that many materials share through setGlobals().
+     * It is bound once per command buffer and stays bound across pipelines, since every template's
+     * layout agrees on set 0.
+     */
     class Material
     {
     public:
+        // What the previous draw in a command buffer bound, so following draws skip rebinding it.
+        struct BindState
+        {
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            VkDescriptorSet globalSet = VK_NULL_HANDLE;
+            VkDescriptorSet materialSet = VK_NULL_HANDLE;
+        };
+
         Material(
             const std::string &vertexShaderPath,
-            const std::string &fragmentShaderPath);
+            const std::string &fragmentShaderPath,
+            VertexFormat vertexFormat = VertexFormat::eFull);
 
         Material();
 
@@ -28,49 +47,69 @@ namespace mcvkp
 
         void addTexture(const std::shared_ptr<Texture> &texture, VkShaderStageFlags shaderStageFlags);
 
+        // One binding whose texture differs per descriptor set: set i samples textures[i % textures.size()].
+        void addTexture(const std::vector<std::shared_ptr<Texture> > &textures, VkShaderStageFlags shaderStageFlags);
+
         void addStorageImage(const std::shared_ptr<Image> &image, VkShaderStageFlags shaderStageFlags);
 
         void addBufferBundle(const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags);
 
+        // Bound after the buffer bundles and before the textures.
+        void addDynamicUniform(const std::shared_ptr<UniformRingBuffer> &ring,
+                               const UniformRingBuffer::Allocation &allocation,
+                               VkShaderStageFlags shaderStageFlags);
+
+        // Bound after the dynamic uniforms and before the textures.
+        void addStorageBufferBundle(const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags);
+
+        // Bound as set 0. Before init.
+        void setGlobals(const std::shared_ptr<ResourceBindings> &globals);
+
         const std::vector<Descriptor<BufferBundle> > &getBufferBundles() const;
 
         const std::vector<Descriptor<Texture> > &getTextures() const;
 
         const std::vector<Descriptor<Image> > &getStorageImages() const;
 
-        // Initialize material when adding to a scene.
+        VertexFormat getVertexFormat() const;
+
+        VkPipelineLayout getPipelineLayout() const;
+
+        // Null until init.
+        std::shared_ptr<PipelineTemplate> getPipelineTemplate() const;
+
+        // Initialize material when adding to a scene. Same as initAsync followed by finishInit.
         void init(const VkRenderPass &renderPass);
 
-        void bind(VkCommandBuffer &commandBuffer, size_t currentFrame);
+        // Starts building the pipeline template on the shared thread pool and returns.
+        void initAsync(const VkRenderPass &renderPass);
 
-    protected:
-        void __initDescriptorSetLayout();
-        void __initDescriptorPool();
-        void __initDescriptorSets();
-        void __initPipeline(
-            const VkExtent2D &swapChainExtent,
-            const VkRenderPass &renderPass,
-            std::string vertexShaderPath,
-            std::string fragmentShaderPath);
-        VkShaderModule __createShaderModule(const std::vector<char> &code);
+        // Whether finishInit would return without waiting.
+        bool isPipelineReady() const;
+
+        // Waits for the pipeline template if needed and creates the descriptor sets. Call from the
+        // thread that records draws, before drawing with the material.
+        void finishInit();
+
+        void bind(VkCommandBuffer &commandBuffer, size_t currentFrame, BindState &bindState);
+
+        // Replaces the material's descriptor sets after resources they point at were recreated, e.g.
+        // by the defragmenter. Frames in flight keep the old sets. The globals are left to their owner.
+        void updateDescriptorSets();
 
     protected:
-        std::vector<Descriptor<BufferBundle> > m_bufferBundleDescriptors;
-        std::vector<Descriptor<Texture> > m_textureDescriptors;
-        std::vector<Descriptor<Image> > m_storageImageDescriptors;
+        ResourceBindings m_resources;
+        std::shared_ptr<ResourceBindings> m_globals;
 
         std::string m_vertexShaderPath;
         std::string m_fragmentShaderPath;
 
-        bool m_initialized;
-
-        uint32_t m_descriptorSetsSize;
+        VertexFormat m_vertexFormat;
 
-        VkPipelineLayout m_pipelineLayout;
-        VkPipeline m_pipeline;
+        bool m_initialized;
 
-        VkDescriptorPool m_descriptorPool;
-        std::vector<VkDescriptorSet> m_descriptorSets;
-        VkDescriptorSetLayout m_descriptorSetLayout;
+        std::shared_ptr<PipelineTemplate> m_pipelineTemplate;
+        // Valid between initAsync and finishInit.
+        PipelineTemplate::Future m_pendingTemplate;
     };
 }
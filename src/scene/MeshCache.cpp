@@ -0,0 +1,401 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "../utils/Hash.h"
+#include "MeshCache.h"
+
+namespace mcvkp
+{
+    namespace MeshCache
+    {
+        namespace
+        {
+            const uint32_t MAGIC = 0x4b56434d; // "MCVK"
+            const size_t SECTION_ALIGNMENT = 16;
+            const uint32_t MAX_SECTIONS = 16;
+
+            enum ImportFlags : uint32_t
+            {
+                eOptimized = 1 << 0,
+                eMeshlets = 1 << 1,
+                eLods = 1 << 2
+            };
+
+            enum class SectionType : uint32_t
+            {
+                eVertices = 1,
+                eIndices = 2,
+                eMeshlets = 3,
+                eLods = 4
+            };
+
+            struct FileHeader
+            {
+                uint32_t magic;
+                uint32_t version;
+                uint64_t pathHash;
+                int64_t sourceModifiedTime;
+                uint64_t sourceSize;
+                uint64_t sourceContentHash;
+                double importMilliseconds;
+                uint32_t sectionCount;
+                uint32_t importFlags;
+            };
+
+            struct SectionHeader
+            {
+                uint32_t type;
+                uint32_t elementSize;
+                uint64_t offset;
+                uint64_t count;
+            };
+
+            struct SourceInfo
+            {
+                uint64_t pathHash;
+                int64_t modifiedTime;
+                uint64_t size;
+            };
+
+            bool querySource(const std::string &modelPath, SourceInfo &info)
+            {
+                std::error_code error;
+                std::filesystem::path path = std::filesystem::absolute(modelPath, error).lexically_normal();
+                if (error)
+                {
+                    return false;
+                }
+                auto modifiedTime = std::filesystem::last_write_time(path, error);
+                if (error)
+                {
+                    return false;
+                }
+                auto size = std::filesystem::file_size(path, error);
+                if (error)
+                {
+                    return false;
+                }
+                info.pathHash = Hash::fnv1a(path.string());
+                info.modifiedTime = static_cast<int64_t>(modifiedTime.time_since_epoch().count());
+                info.size = static_cast<uint64_t>(size);
+                return true;
+            }
+
+            bool hashSourceContent(const std::string &modelPath, uint64_t &hash)
+            {
+                MappedFile source(modelPath);
+                if (!source.isOpen())
+                {
+                    return false;
+                }
+                hash = Hash::fnv1a(source.data(), source.size());
+                return true;
+            }
+
+            // Options that change the imported data. Options that only change how it is computed are left out.
+            uint32_t importFlags(const MeshImportOptions &options)
+            {
+                uint32_t flags = 0;
+                if (options.optimize)
+                {
+                    flags |= ImportFlags::eOptimized;
+                }
+                if (options.buildMeshlets)
+                {
+                    flags |= ImportFlags::eMeshlets;
+                }
+                if (options.buildLods)
+                {
+                    flags |= ImportFlags::eLods;
+                }
+                return flags;
+            }
+
+            size_t alignUp(size_t value, size_t alignment)
+            {
+                return (value + alignment - 1) / alignment * alignment;
+            }
+
+            // Every range must lie inside the index buffer, or drawing it reads past the end.
+            template <typename T>
+            bool rangesInside(const T *ranges, size_t count, size_t indexCount)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    if (static_cast<uint64_t>(ranges[i].firstIndex) + ranges[i].indexCount > indexCount)
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+            {
+                auto end = std::chrono::high_resolution_clock::now();
+                return std::chrono::duration<double, std::milli>(end - start).count();
+            }
+        }
+
+        std::string cachePath(const std::string &modelPath)
+        {
+            return modelPath + ".mcache";
+        }
+
+        bool load(const std::string &modelPath, const MeshImportOptions &options, Entry &entry)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            SourceInfo source;
+            if (!querySource(modelPath, source))
+            {
+                return false;
+            }
+
+            std::string path = cachePath(modelPath);
+            MappedFile file(path);
+            if (!file.isOpen() || file.size() < sizeof(FileHeader))
+            {
+                return false;
+            }
+
+            FileHeader header;
+            memcpy(&header, file.data(), sizeof(header));
+            if (header.magic != MAGIC || header.version != VERSION || header.pathHash != source.pathHash ||
+                header.importFlags != importFlags(options))
+            {
+                return false;
+            }
+
+            if (header.sourceModifiedTime != source.modifiedTime || header.sourceSize != source.size)
+            {
+                // The file was touched. It is still a hit if the content did not change.
+                uint64_t contentHash;
+                if (header.sourceSize != source.size ||
+                    !hashSourceContent(modelPath, contentHash) ||
+                    contentHash != header.sourceContentHash)
+                {
+                    return false;
+                }
+                // Remember the new time so the next launch skips hashing. Windows does not allow
+                // writing to a file that is mapped, so the mapping is released and made again after.
+                file.close();
+                std::fstream patch(path, std::ios::in | std::ios::out | std::ios::binary);
+                patch.seekp(offsetof(FileHeader, sourceModifiedTime));
+                patch.write(reinterpret_cast<const char *>(&source.modifiedTime), sizeof(source.modifiedTime));
+                patch.close();
+                if (patch.fail())
+                {
+                    std::cout << "Failed to update the source time in " << path << ", the OBJ will be hashed again next launch"
+                              << "\n";
+                }
+
+                file = MappedFile(path);
+                if (!file.isOpen() || file.size() < sizeof(FileHeader))
+                {
+                    return false;
+                }
+            }
+
+            size_t tableEnd = sizeof(FileHeader) + header.sectionCount * sizeof(SectionHeader);
+            if (header.sectionCount > MAX_SECTIONS || file.size() < tableEnd)
+            {
+                return false;
+            }
+
+            const Vertex *vertices = nullptr;
+            const uint32_t *indices = nullptr;
+            const Meshlet *meshlets = nullptr;
+            const MeshLod *lods = nullptr;
+            size_t vertexCount = 0;
+            size_t indexCount = 0;
+            size_t meshletCount = 0;
+            size_t lodCount = 0;
+            for (uint32_t i = 0; i < header.sectionCount; i++)
+            {
+                SectionHeader section;
+                memcpy(&section, file.data() + sizeof(FileHeader) + i * sizeof(SectionHeader), sizeof(section));
+                if (section.elementSize == 0 ||
+                    section.offset % SECTION_ALIGNMENT != 0 ||
+                    section.offset > file.size() ||
+                    section.count > (file.size() - section.offset) / section.elementSize)
+                {
+                    return false;
+                }
+
+                const char *data = file.data() + section.offset;
+                switch (static_cast<SectionType>(section.type))
+                {
+                case SectionType::eVertices:
+                    if (section.elementSize != sizeof(Vertex))
+                    {
+                        return false;
+                    }
+                    vertices = reinterpret_cast<const Vertex *>(data);
+                    vertexCount = section.count;
+                    break;
+                case SectionType::eIndices:
+                    if (section.elementSize != sizeof(uint32_t))
+                    {
+                        return false;
+                    }
+                    indices = reinterpret_cast<const uint32_t *>(data);
+                    indexCount = section.count;
+                    break;
+                case SectionType::eMeshlets:
+                    if (section.elementSize != sizeof(Meshlet))
+                    {
+                        return false;
+                    }
+                    meshlets = reinterpret_cast<const Meshlet *>(data);
+                    meshletCount = section.count;
+                    break;
+                case SectionType::eLods:
+                    if (section.elementSize != sizeof(MeshLod))
+                    {
+                        return false;
+                    }
+                    lods = reinterpret_cast<const MeshLod *>(data);
+                    lodCount = section.count;
+                    break;
+                default:
+                    // Unknown sections are skipped.
+                    break;
+                }
+            }
+
+            if (vertices == nullptr || indices == nullptr || (options.buildMeshlets && meshlets == nullptr) ||
+                (options.buildLods && lods == nullptr))
+            {
+                return false;
+            }
+
+            // A damaged or stale file that got past the header checks must not reach the GPU.
+            for (size_t i = 0; i < indexCount; i++)
+            {
+                if (indices[i] >= vertexCount)
+                {
+                    std::cout << "Mesh cache for " << modelPath << " has out of range indices, importing again"
+                              << "\n";
+                    return false;
+                }
+            }
+            if (!rangesInside(meshlets, meshletCount, indexCount) || !rangesInside(lods, lodCount, indexCount))
+            {
+                std::cout << "Mesh cache for " << modelPath << " has meshlets or LODs outside its index buffer, importing again"
+                          << "\n";
+                return false;
+            }
+
+            entry.m_file = std::move(file);
+            entry.m_vertices = vertices;
+            entry.m_vertexCount = vertexCount;
+            entry.m_indices = indices;
+            entry.m_indexCount = indexCount;
+            entry.m_meshlets = meshlets;
+            entry.m_meshletCount = meshletCount;
+            entry.m_lods = lods;
+            entry.m_lodCount = lodCount;
+            entry.m_importMilliseconds = header.importMilliseconds;
+
+            double loadMilliseconds = millisecondsSince(start);
+            std::cout << "Mesh cache hit for " << modelPath << ": "
+                      << vertexCount << " vertices, " << indexCount << " indices in " << loadMilliseconds << " ms"
+                      << " (OBJ import took " << header.importMilliseconds << " ms)"
+                      << "\n";
+            return true;
+        }
+
+        void store(const std::string &modelPath, const MeshImportOptions &options, const Mesh &mesh, double importMilliseconds)
+        {
+            SourceInfo source;
+            FileHeader header{};
+            if (!querySource(modelPath, source) || !hashSourceContent(modelPath, header.sourceContentHash))
+            {
+                return;
+            }
+
+            header.magic = MAGIC;
+            header.version = VERSION;
+            header.pathHash = source.pathHash;
+            header.sourceModifiedTime = source.modifiedTime;
+            header.sourceSize = source.size;
+            header.importMilliseconds = importMilliseconds;
+            header.importFlags = importFlags(options);
+
+            struct SectionData
+            {
+                SectionType type;
+                uint32_t elementSize;
+                size_t count;
+                const void *data;
+            };
+            std::vector<SectionData> sectionData = {
+                {SectionType::eVertices, sizeof(Vertex), mesh.vertices.size(), mesh.vertices.data()},
+                {SectionType::eIndices, sizeof(uint32_t), mesh.indices.size(), mesh.indices.data()}};
+            if (!mesh.meshlets.empty())
+            {
+                sectionData.push_back({SectionType::eMeshlets, sizeof(Meshlet), mesh.meshlets.size(), mesh.meshlets.data()});
+            }
+            if (!mesh.lods.empty())
+            {
+                sectionData.push_back({SectionType::eLods, sizeof(MeshLod), mesh.lods.size(), mesh.lods.data()});
+            }
+            header.sectionCount = static_cast<uint32_t>(sectionData.size());
+
+            std::vector<SectionHeader> sections(header.sectionCount);
+            size_t offset = alignUp(sizeof(FileHeader) + sections.size() * sizeof(SectionHeader), SECTION_ALIGNMENT);
+            for (size_t i = 0; i < sections.size(); i++)
+            {
+                sections[i].type = static_cast<uint32_t>(sectionData[i].type);
+                sections[i].elementSize = sectionData[i].elementSize;
+                sections[i].offset = offset;
+                sections[i].count = sectionData[i].count;
+                offset = alignUp(offset + sectionData[i].count * sectionData[i].elementSize, SECTION_ALIGNMENT);
+            }
+
+            // Write to a temporary file and rename it so a crash never leaves a torn cache behind.
+            std::string path = cachePath(modelPath);
+            std::string tmpPath = path + ".tmp";
+            {
+                std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+                if (!file.is_open())
+                {
+                    return;
+                }
+                file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                file.write(reinterpret_cast<const char *>(sections.data()), sections.size() * sizeof(SectionHeader));
+
+                const char padding[SECTION_ALIGNMENT] = {};
+                for (size_t i = 0; i < sections.size(); i++)
+                {
+                    file.write(padding, sections[i].offset - static_cast<uint64_t>(file.tellp()));
+                    file.write(static_cast<const char *>(sectionData[i].data), sectionData[i].count * sectionData[i].elementSize);
+                }
+
+                if (!file.good())
+                {
+                    file.close();
+                    std::remove(tmpPath.c_str());
+                    return;
+                }
+            }
+
+            std::error_code error;
+            std::filesystem::rename(tmpPath, path, error);
+            if (error)
+            {
+                std::remove(tmpPath.c_str());
+                return;
+            }
+
+            std::cout << "Mesh cache written for " << modelPath << " (OBJ import took " << importMilliseconds << " ms)"
+                      << "\n";
+        }
+    }
+}
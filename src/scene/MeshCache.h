@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include "Mesh.h"
+#include "../utils/MappedFile.h"
+
+namespace mcvkp
+{
+    /**
+     * Binary cache of imported meshes. The cache file lives next to the model ("cheems.obj.mcache")
+     * and holds the vertex, index, meshlet and LOD arrays exactly as Mesh produces them.
+     *
+     * A cache entry is valid for a source file if the path matches and either the modification time
+     * and size match, or the content hash does (e.g. the file was touched by a checkout). Import options
+     * that change the result are part of the key, so an optimized and a plain import never share an entry.
+     */
+    namespace MeshCache
+    {
+        // Bump whenever the file layout or the import result for the same OBJ changes.
+        const uint32_t VERSION = 2;
+
+        // A loaded cache file. Vertex and index data point straight into the memory mapping.
+        class Entry
+        {
+        public:
+            const Vertex *vertices() const { return m_vertices; }
+            size_t vertexCount() const { return m_vertexCount; }
+            const uint32_t *indices() const { return m_indices; }
+            size_t indexCount() const { return m_indexCount; }
+            // Empty unless the entry was imported with buildMeshlets.
+            const Meshlet *meshlets() const { return m_meshlets; }
+            size_t meshletCount() const { return m_meshletCount; }
+            // Empty unless the entry was imported with buildLods.
+            const MeshLod *lods() const { return m_lods; }
+            size_t lodCount() const { return m_lodCount; }
+
+            // Time the OBJ import took when the entry was written.
+            double importMilliseconds() const { return m_importMilliseconds; }
+
+        private:
+            friend bool load(const std::string &modelPath, const MeshImportOptions &options, Entry &entry);
+
+            MappedFile m_file;
+            const Vertex *m_vertices = nullptr;
+            size_t m_vertexCount = 0;
+            const uint32_t *m_indices = nullptr;
+            size_t m_indexCount = 0;
+            const Meshlet *m_meshlets = nullptr;
+            size_t m_meshletCount = 0;
+            const MeshLod *m_lods = nullptr;
+            size_t m_lodCount = 0;
+            double m_importMilliseconds = 0.0;
+        };
+
+        std::string cachePath(const std::string &modelPath);
+
+        // Returns false if there is no valid cache entry for the model.
+        bool load(const std::string &modelPath, const MeshImportOptions &options, Entry &entry);
+
+        // Writes the cache entry for the model. Failing to write the cache is not an error.
+        void store(const std::string &modelPath, const MeshImportOptions &options, const Mesh &mesh, double importMilliseconds);
+    }
+}
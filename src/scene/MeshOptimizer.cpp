@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <numeric>
+#include "MeshOptimizer.h"
+
+namespace mcvkp
+{
+    namespace MeshOptimizer
+    {
+        namespace
+        {
+            const uint32_t NO_VERTEX = 0xffffffffu;
+
+            // FIFO cache simulated with timestamps: a vertex is a hit if it entered the cache
+            // fewer than CACHE_SIZE misses ago. Returns the number of misses for the triangle.
+            uint32_t updateCache(const uint32_t *triangle, std::vector<uint32_t> &timestamps, uint32_t &time)
+            {
+                uint32_t misses = 0;
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t v = triangle[k];
+                    if (time - timestamps[v] > CACHE_SIZE)
+                    {
+                        timestamps[v] = time++;
+                        misses++;
+                    }
+                }
+                return misses;
+            }
+        }
+
+        CacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t numVertices)
+        {
+            CacheStats stats{0.0f, 0.0f};
+            size_t numTriangles = indices.size() / 3;
+            if (numTriangles == 0 || numVertices == 0)
+            {
+                return stats;
+            }
+
+            std::vector<uint32_t> timestamps(numVertices, 0);
+            uint32_t time = CACHE_SIZE + 1;
+            size_t misses = 0;
+            for (size_t t = 0; t < numTriangles; t++)
+            {
+                misses += updateCache(&indices[3 * t], timestamps, time);
+            }
+
+            stats.acmr = static_cast<float>(misses) / numTriangles;
+            stats.atvr = static_cast<float>(misses) / numVertices;
+            return stats;
+        }
+
+        void optimizeVertexCache(std::vector<uint32_t> &indices, size_t numVertices, std::vector<uint32_t> &clusters)
+        {
+            clusters.clear();
+            size_t numTriangles = indices.size() / 3;
+            if (numTriangles == 0)
+            {
+                return;
+            }
+
+            // Triangles adjacent to each vertex, and how many of them are not emitted yet.
+            std::vector<uint32_t> live(numVertices, 0);
+            for (uint32_t index : indices)
+            {
+                live[index]++;
+            }
+            std::vector<uint32_t> offsets(numVertices + 1, 0);
+            for (size_t v = 0; v < numVertices; v++)
+            {
+                offsets[v + 1] = offsets[v] + live[v];
+            }
+            std::vector<uint32_t> adjacency(indices.size());
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t t = 0; t < numTriangles; t++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    adjacency[fill[indices[3 * t + k]]++] = static_cast<uint32_t>(t);
+                }
+            }
+
+            std::vector<uint32_t> timestamps(numVertices, 0);
+            uint32_t time = CACHE_SIZE + 1;
+            std::vector<uint8_t> emitted(numTriangles, 0);
+            std::vector<uint32_t> deadEnd;
+            deadEnd.reserve(indices.size());
+            std::vector<uint32_t> candidates;
+            std::vector<uint32_t> result;
+            result.reserve(indices.size());
+            size_t cursor = 0;
+
+            clusters.push_back(0);
+            uint32_t fanning = indices[0];
+            while (true)
+            {
+                // Emit every remaining triangle around the fanning vertex.
+                candidates.clear();
+                for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+                {
+                    uint32_t t = adjacency[a];
+                    if (emitted[t])
+                    {
+                        continue;
+                    }
+                    for (int k = 0; k < 3; k++)
+                    {
+                        uint32_t v = indices[3 * t + k];
+                        result.push_back(v);
+                        deadEnd.push_back(v);
+                        candidates.push_back(v);
+                        live[v]--;
+                        if (time - timestamps[v] > CACHE_SIZE)
+                        {
+                            timestamps[v] = time++;
+                        }
+                    }
+                    emitted[t] = 1;
+                }
+
+                // Next fanning vertex: the oldest candidate that will still be cached after its own fan.
+                uint32_t next = NO_VERTEX;
+                int64_t bestPriority = -1;
+                for (uint32_t v : candidates)
+                {
+                    if (live[v] == 0)
+                    {
+                        continue;
+                    }
+                    int64_t priority = 0;
+                    if (time - timestamps[v] + 2 * live[v] <= CACHE_SIZE)
+                    {
+                        priority = time - timestamps[v];
+                    }
+                    if (priority > bestPriority)
+                    {
+                        bestPriority = priority;
+                        next = v;
+                    }
+                }
+
+                if (next == NO_VERTEX)
+                {
+                    // Dead end: back up to a recently used vertex, else take the next one in input order.
+                    while (!deadEnd.empty() && next == NO_VERTEX)
+                    {
+                        uint32_t v = deadEnd.back();
+                        deadEnd.pop_back();
+                        if (live[v] > 0)
+                        {
+                            next = v;
+                        }
+                    }
+                    while (cursor < numVertices && next == NO_VERTEX)
+                    {
+                        if (live[cursor] > 0)
+                        {
+                            next = static_cast<uint32_t>(cursor);
+                        }
+                        cursor++;
+                    }
+                    if (next == NO_VERTEX)
+                    {
+                        break;
+                    }
+                    clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+                }
+                fanning = next;
+            }
+
+            indices.swap(result);
+        }
+
+        void optimizeOverdraw(std::vector<uint32_t> &indices,
+                              const std::vector<Vertex> &vertices,
+                              const std::vector<uint32_t> &clusters,
+                              float threshold)
+        {
+            size_t numTriangles = indices.size() / 3;
+            if (numTriangles == 0 || clusters.empty())
+            {
+                return;
+            }
+
+            // Split each cluster wherever the part so far already reaches the cluster's ACMR
+            // (within the threshold), so sorting has finer pieces to work with.
+            std::vector<uint32_t> timestamps(vertices.size(), 0);
+            uint32_t time = CACHE_SIZE + 1;
+            std::vector<uint32_t> boundaries;
+            for (size_t c = 0; c < clusters.size(); c++)
+            {
+                size_t start = clusters[c];
+                size_t end = c + 1 < clusters.size() ? clusters[c + 1] : numTriangles;
+
+                time += CACHE_SIZE + 1;
+                uint32_t clusterMisses = 0;
+                for (size_t t = start; t < end; t++)
+                {
+                    clusterMisses += updateCache(&indices[3 * t], timestamps, time);
+                }
+                float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+                boundaries.push_back(static_cast<uint32_t>(start));
+                time += CACHE_SIZE + 1;
+                uint32_t runningMisses = 0;
+                uint32_t runningTriangles = 0;
+                for (size_t t = start; t < end; t++)
+                {
+                    runningMisses += updateCache(&indices[3 * t], timestamps, time);
+                    runningTriangles++;
+                    if (static_cast<float>(runningMisses) / runningTriangles <= clusterThreshold)
+                    {
+                        boundaries.push_back(static_cast<uint32_t>(t + 1));
+                        time += CACHE_SIZE + 1;
+                        runningMisses = 0;
+                        runningTriangles = 0;
+                    }
+                }
+                // The tail after the last split is usually a poor cluster on its own, merge it back.
+                // This also drops a boundary that landed exactly on `end`.
+                if (boundaries.back() != start)
+                {
+                    boundaries.pop_back();
+                }
+            }
+
+            // Area-weighted centroid and normal per cluster.
+            size_t numClusters = boundaries.size();
+            std::vector<glm::vec3> centroids(numClusters, glm::vec3(0.0f));
+            std::vector<glm::vec3> normals(numClusters, glm::vec3(0.0f));
+            std::vector<float> areas(numClusters, 0.0f);
+            glm::vec3 meshCentroid(0.0f);
+            float meshArea = 0.0f;
+            for (size_t c = 0; c < numClusters; c++)
+            {
+                size_t start = boundaries[c];
+                size_t end = c + 1 < numClusters ? boundaries[c + 1] : numTriangles;
+                for (size_t t = start; t < end; t++)
+                {
+                    const glm::vec3 &a = vertices[indices[3 * t + 0]].pos;
+                    const glm::vec3 &b = vertices[indices[3 * t + 1]].pos;
+                    const glm::vec3 &d = vertices[indices[3 * t + 2]].pos;
+                    glm::vec3 normal = glm::cross(b - a, d - a);
+                    float area = glm::length(normal);
+                    centroids[c] += (a + b + d) * (area / 3.0f);
+                    normals[c] += normal;
+                    areas[c] += area;
+                }
+                meshCentroid += centroids[c];
+                meshArea += areas[c];
+            }
+            if (meshArea > 0.0f)
+            {
+                meshCentroid /= meshArea;
+            }
+
+            // Clusters far out along their own normal are likely to occlude the rest, draw them first.
+            std::vector<float> sortKeys(numClusters, 0.0f);
+            for (size_t c = 0; c < numClusters; c++)
+            {
+                float normalLength = glm::length(normals[c]);
+                if (areas[c] > 0.0f && normalLength > 0.0f)
+                {
+                    sortKeys[c] = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / normalLength);
+                }
+            }
+            std::vector<uint32_t> order(numClusters);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+            std::vector<uint32_t> result;
+            result.reserve(indices.size());
+            for (uint32_t c : order)
+            {
+                size_t start = boundaries[c];
+                size_t end = c + 1 < numClusters ? boundaries[c + 1] : numTriangles;
+                result.insert(result.end(), indices.begin() + 3 * start, indices.begin() + 3 * end);
+            }
+            indices.swap(result);
+        }
+
+        void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+        {
+            std::vector<uint32_t> remap(vertices.size(), NO_VERTEX);
+            std::vector<Vertex> result;
+            result.reserve(vertices.size());
+            for (uint32_t &index : indices)
+            {
+                if (remap[index] == NO_VERTEX)
+                {
+                    remap[index] = static_cast<uint32_t>(result.size());
+                    result.push_back(vertices[index]);
+                }
+                index = remap[index];
+            }
+            vertices.swap(result);
+        }
+
+        void optimize(Mesh &mesh, CacheStats &before, CacheStats &after)
+        {
+            before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+            std::vector<uint32_t> clusters;
+            optimizeVertexCache(mesh.indices, mesh.vertices.size(), clusters);
+            optimizeOverdraw(mesh.indices, mesh.vertices, clusters);
+            optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+            after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Mesh.h"
+
+namespace mcvkp
+{
+    namespace MeshOptimizer
+    {
+        // Post-transform cache size the reordering targets and the statistics simulate.
+        const uint32_t CACHE_SIZE = 16;
+
+        struct CacheStats
+        {
+            // Average cache miss ratio: vertex shader invocations per triangle (0.5 is ideal, 3 is worst).
+            float acmr;
+            // Average transform to vertex ratio: invocations per unique vertex (1 is ideal).
+            float atvr;
+        };
+
+        // Simulates a FIFO post-transform cache of CACHE_SIZE entries over the index buffer.
+        CacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t numVertices);
+
+        /**
+         * Reorders triangles for vertex cache reuse with Tipsify (Sander et al. 2007). Also returns
+         * the triangle offsets at which the algorithm had to restart, which split the output into
+         * clusters whose internal order should be kept.
+         */
+        void optimizeVertexCache(std::vector<uint32_t> &indices, size_t numVertices, std::vector<uint32_t> &clusters);
+
+        /**
+         * Reorders the clusters produced by optimizeVertexCache so that triangles facing away from
+         * the mesh center come first and occlude the rest. Clusters are first split further where
+         * it costs less than `threshold` times the current ACMR.
+         */
+        void optimizeOverdraw(std::vector<uint32_t> &indices,
+                              const std::vector<Vertex> &vertices,
+                              const std::vector<uint32_t> &clusters,
+                              float threshold = 1.05f);
+
+        // Reorders vertices in the order the index buffer first uses them and rewrites the indices.
+        void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+        // Runs all three passes in order and returns the cache statistics before and after.
+        void optimize(Mesh &mesh, CacheStats &before, CacheStats &after);
+    }
+}
@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+namespace mcvkp
+{
+    namespace MeshSimplifier
+    {
+        namespace
+        {
+            // A level must drop at least this fraction of the previous one to be kept.
+            const float MIN_LOD_REDUCTION = 0.1f;
+
+            // Symmetric 3x3 matrix A, vector b and scalar c of the area-weighted sum of squared
+            // plane distances: error(p) = p^T A p + 2 b.p + c. w is the total weight.
+            struct Quadric
+            {
+                float a00, a11, a22, a01, a02, a12;
+                float b0, b1, b2;
+                float c;
+                float w;
+            };
+
+            void addPlane(Quadric &q, const glm::vec3 &n, float d, float w)
+            {
+                q.a00 += w * n.x * n.x;
+                q.a11 += w * n.y * n.y;
+                q.a22 += w * n.z * n.z;
+                q.a01 += w * n.x * n.y;
+                q.a02 += w * n.x * n.z;
+                q.a12 += w * n.y * n.z;
+                q.b0 += w * n.x * d;
+                q.b1 += w * n.y * d;
+                q.b2 += w * n.z * d;
+                q.c += w * d * d;
+                q.w += w;
+            }
+
+            void addQuadric(Quadric &q, const Quadric &other)
+            {
+                q.a00 += other.a00;
+                q.a11 += other.a11;
+                q.a22 += other.a22;
+                q.a01 += other.a01;
+                q.a02 += other.a02;
+                q.a12 += other.a12;
+                q.b0 += other.b0;
+                q.b1 += other.b1;
+                q.b2 += other.b2;
+                q.c += other.c;
+                q.w += other.w;
+            }
+
+            // Mean squared distance of p to the planes in q and r together.
+            float evaluate(const Quadric &q, const Quadric &r, const glm::vec3 &p)
+            {
+                Quadric sum = q;
+                addQuadric(sum, r);
+                float rx = sum.a00 * p.x + sum.a01 * p.y + sum.a02 * p.z;
+                float ry = sum.a01 * p.x + sum.a11 * p.y + sum.a12 * p.z;
+                float rz = sum.a02 * p.x + sum.a12 * p.y + sum.a22 * p.z;
+                float error = rx * p.x + ry * p.y + rz * p.z + 2.0f * (sum.b0 * p.x + sum.b1 * p.y + sum.b2 * p.z) + sum.c;
+                return sum.w > 0.0f ? std::abs(error) / sum.w : 0.0f;
+            }
+
+            struct Collapse
+            {
+                uint32_t from;
+                uint32_t to;
+                float cost;
+            };
+
+            // Locks every vertex whose position is shared with another vertex (attribute seam) or
+            // lies on an edge used by a single triangle (open border).
+            void findLockedVertices(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, std::vector<uint8_t> &locked)
+            {
+                size_t numVertices = vertices.size();
+                std::vector<uint32_t> order(numVertices);
+                std::iota(order.begin(), order.end(), 0);
+                std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                    const glm::vec3 &pa = vertices[a].pos;
+                    const glm::vec3 &pb = vertices[b].pos;
+                    return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+                });
+
+                std::vector<uint32_t> positionId(numVertices);
+                std::vector<uint32_t> groupSize;
+                for (size_t i = 0; i < numVertices; i++)
+                {
+                    if (i == 0 || vertices[order[i]].pos != vertices[order[i - 1]].pos)
+                    {
+                        groupSize.push_back(0);
+                    }
+                    positionId[order[i]] = static_cast<uint32_t>(groupSize.size() - 1);
+                    groupSize.back()++;
+                }
+
+                std::vector<uint8_t> lockedPosition(groupSize.size(), 0);
+                for (size_t p = 0; p < groupSize.size(); p++)
+                {
+                    lockedPosition[p] = groupSize[p] > 1;
+                }
+
+                std::vector<uint64_t> edges;
+                edges.reserve(indices.size());
+                for (size_t i = 0; i + 2 < indices.size(); i += 3)
+                {
+                    for (int k = 0; k < 3; k++)
+                    {
+                        uint64_t a = positionId[indices[i + k]];
+                        uint64_t b = positionId[indices[i + (k + 1) % 3]];
+                        edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+                    }
+                }
+                std::sort(edges.begin(), edges.end());
+                for (size_t i = 0; i < edges.size();)
+                {
+                    size_t j = i;
+                    while (j < edges.size() && edges[j] == edges[i])
+                    {
+                        j++;
+                    }
+                    if (j - i == 1)
+                    {
+                        lockedPosition[edges[i] >> 32] = 1;
+                        lockedPosition[edges[i] & 0xffffffffu] = 1;
+                    }
+                    i = j;
+                }
+
+                locked.resize(numVertices);
+                for (size_t v = 0; v < numVertices; v++)
+                {
+                    locked[v] = lockedPosition[positionId[v]];
+                }
+            }
+        }
+
+        float simplify(const std::vector<Vertex> &vertices,
+                       const std::vector<uint32_t> &indices,
+                       size_t targetIndexCount,
+                       float maxError,
+                       std::vector<uint32_t> &result)
+        {
+            size_t numVertices = vertices.size();
+            result = indices;
+
+            std::vector<uint8_t> locked;
+            findLockedVertices(vertices, indices, locked);
+
+            std::vector<Quadric> quadrics(numVertices, Quadric{});
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                const glm::vec3 &a = vertices[indices[i + 0]].pos;
+                const glm::vec3 &b = vertices[indices[i + 1]].pos;
+                const glm::vec3 &c = vertices[indices[i + 2]].pos;
+                glm::vec3 normal = glm::cross(b - a, c - a);
+                float area = glm::length(normal);
+                if (area == 0.0f)
+                {
+                    continue;
+                }
+                normal /= area;
+                float d = -glm::dot(normal, a);
+                for (int k = 0; k < 3; k++)
+                {
+                    addPlane(quadrics[indices[i + k]], normal, d, area);
+                }
+            }
+
+            float maxErrorSquared = maxError < FLT_MAX ? maxError * maxError : FLT_MAX;
+            float resultError = 0.0f;
+            std::vector<uint32_t> offsets(numVertices + 1);
+            std::vector<uint32_t> adjacency;
+            std::vector<Collapse> collapses;
+            std::vector<uint32_t> remap(numVertices);
+            std::vector<uint8_t> touched(numVertices);
+
+            // Each pass collapses an independent set of edges, cheapest first, then rebuilds the indices.
+            while (result.size() > targetIndexCount)
+            {
+                size_t numTriangles = result.size() / 3;
+                std::fill(offsets.begin(), offsets.end(), 0);
+                for (uint32_t index : result)
+                {
+                    offsets[index + 1]++;
+                }
+                for (size_t v = 0; v < numVertices; v++)
+                {
+                    offsets[v + 1] += offsets[v];
+                }
+                adjacency.resize(result.size());
+                std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+                for (size_t t = 0; t < numTriangles; t++)
+                {
+                    for (int k = 0; k < 3; k++)
+                    {
+                        adjacency[fill[result[3 * t + k]]++] = static_cast<uint32_t>(t);
+                    }
+                }
+
+                collapses.clear();
+                for (size_t t = 0; t < numTriangles; t++)
+                {
+                    for (int k = 0; k < 3; k++)
+                    {
+                        uint32_t a = result[3 * t + k];
+                        uint32_t b = result[3 * t + (k + 1) % 3];
+                        if (a == b)
+                        {
+                            continue;
+                        }
+                        if (!locked[a])
+                        {
+                            collapses.push_back({a, b, evaluate(quadrics[a], quadrics[b], vertices[b].pos)});
+                        }
+                        if (!locked[b])
+                        {
+                            collapses.push_back({b, a, evaluate(quadrics[a], quadrics[b], vertices[a].pos)});
+                        }
+                    }
+                }
+                std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+                std::iota(remap.begin(), remap.end(), 0);
+                std::fill(touched.begin(), touched.end(), 0);
+                size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+                size_t trianglesRemoved = 0;
+                size_t numCollapsed = 0;
+                for (const Collapse &collapse : collapses)
+                {
+                    if (collapse.cost > maxErrorSquared || trianglesRemoved >= trianglesToRemove)
+                    {
+                        break;
+                    }
+                    if (touched[collapse.from] || touched[collapse.to])
+                    {
+                        continue;
+                    }
+
+                    // Reject the collapse if it would flip a triangle that survives it.
+                    const glm::vec3 &target = vertices[collapse.to].pos;
+                    bool flips = false;
+                    size_t removed = 0;
+                    for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && !flips; a++)
+                    {
+                        const uint32_t *triangle = &result[3 * adjacency[a]];
+                        if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                        {
+                            removed++;
+                            continue;
+                        }
+                        glm::vec3 p[3], q[3];
+                        for (int k = 0; k < 3; k++)
+                        {
+                            p[k] = vertices[triangle[k]].pos;
+                            q[k] = triangle[k] == collapse.from ? target : p[k];
+                        }
+                        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                        glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                        flips = glm::dot(before, after) <= 0.0f;
+                    }
+                    if (flips)
+                    {
+                        continue;
+                    }
+
+                    // Keep the collapses of one pass independent: nothing around `from` moves again.
+                    for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+                    {
+                        const uint32_t *triangle = &result[3 * adjacency[a]];
+                        touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+                    }
+                    touched[collapse.to] = 1;
+
+                    remap[collapse.from] = collapse.to;
+                    addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+                    resultError = std::max(resultError, collapse.cost);
+                    trianglesRemoved += removed;
+                    numCollapsed++;
+                }
+
+                if (numCollapsed == 0)
+                {
+                    break;
+                }
+
+                size_t write = 0;
+                for (size_t t = 0; t < numTriangles; t++)
+                {
+                    uint32_t a = remap[result[3 * t + 0]];
+                    uint32_t b = remap[result[3 * t + 1]];
+                    uint32_t c = remap[result[3 * t + 2]];
+                    if (a == b || b == c || a == c)
+                    {
+                        continue;
+                    }
+                    result[write++] = a;
+                    result[write++] = b;
+                    result[write++] = c;
+                }
+                result.resize(write);
+            }
+
+            return std::sqrt(resultError);
+        }
+
+        void buildLods(Mesh &mesh, bool optimize)
+        {
+            mesh.lods.clear();
+            mesh.lods.push_back({0, static_cast<uint32_t>(mesh.indices.size()), 0.0f});
+
+            std::vector<uint32_t> level = mesh.indices;
+            std::vector<uint32_t> simplified;
+            float error = 0.0f;
+            while (mesh.lods.size() < MAX_LODS)
+            {
+                size_t target = level.size() / 6 * 3;
+                float levelError = simplify(mesh.vertices, level, target, FLT_MAX, simplified);
+                if (simplified.empty() || simplified.size() > level.size() * (1.0f - MIN_LOD_REDUCTION))
+                {
+                    break;
+                }
+
+                // Each level is simplified from the previous one, so the errors add up.
+                error += levelError;
+                if (optimize)
+                {
+                    std::vector<uint32_t> clusters;
+                    MeshOptimizer::optimizeVertexCache(simplified, mesh.vertices.size(), clusters);
+                    MeshOptimizer::optimizeOverdraw(simplified, mesh.vertices, clusters);
+                }
+
+                mesh.lods.push_back({static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(simplified.size()), error});
+                mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+                level.swap(simplified);
+            }
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Mesh.h"
+
+namespace mcvkp
+{
+    namespace MeshSimplifier
+    {
+        // Most levels generated by buildLods, including full detail.
+        const uint32_t MAX_LODS = 6;
+
+        /**
+         * Quadric error edge collapse (Garland and Heckbert 1997). Vertices collapse onto a neighbour,
+         * so the result indexes the same vertex array and no vertex is created or moved. Vertices on
+         * an open border or an attribute seam (several vertices sharing a position) never move.
+         *
+         * Stops when the result has at most targetIndexCount indices, when the next collapse would
+         * cost more than maxError, or when nothing can be collapsed anymore. Returns the error of the
+         * result: the largest estimated distance, in model units, from a collapsed vertex to the
+         * surface it replaced.
+         */
+        float simplify(const std::vector<Vertex> &vertices,
+                       const std::vector<uint32_t> &indices,
+                       size_t targetIndexCount,
+                       float maxError,
+                       std::vector<uint32_t> &result);
+
+        /**
+         * Appends simplified levels, each about half the triangles of the previous one, to the index
+         * buffer and lists all levels, starting with the full mesh, in mesh.lods. Stops early once a
+         * level barely gets smaller. With optimize set each level is reordered for the vertex cache.
+         */
+        void buildLods(Mesh &mesh, bool optimize);
+    }
+}
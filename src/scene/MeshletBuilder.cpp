@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cmath>
+#include "MeshletBuilder.h"
+
+namespace mcvkp
+{
+    namespace MeshletBuilder
+    {
+        namespace
+        {
+            const uint32_t NO_TRIANGLE = 0xffffffffu;
+            const uint32_t NO_MESHLET = 0xffffffffu;
+        }
+
+        Meshlet computeBounds(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+                              uint32_t firstIndex, uint32_t indexCount)
+        {
+            Meshlet meshlet{};
+            meshlet.firstIndex = firstIndex;
+            meshlet.indexCount = indexCount;
+
+            glm::vec3 boundsMin = vertices[indices[firstIndex]].pos;
+            glm::vec3 boundsMax = boundsMin;
+            for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+            {
+                boundsMin = glm::min(boundsMin, vertices[indices[i]].pos);
+                boundsMax = glm::max(boundsMax, vertices[indices[i]].pos);
+            }
+            meshlet.center = (boundsMin + boundsMax) * 0.5f;
+            for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+            {
+                meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].pos - meshlet.center));
+            }
+
+            std::vector<glm::vec3> normals;
+            normals.reserve(indexCount / 3);
+            glm::vec3 axis(0.0f);
+            for (uint32_t i = firstIndex; i + 2 < firstIndex + indexCount; i += 3)
+            {
+                const glm::vec3 &a = vertices[indices[i + 0]].pos;
+                const glm::vec3 &b = vertices[indices[i + 1]].pos;
+                const glm::vec3 &c = vertices[indices[i + 2]].pos;
+                glm::vec3 normal = glm::cross(b - a, c - a);
+                float length = glm::length(normal);
+                if (length > 0.0f)
+                {
+                    normals.push_back(normal / length);
+                    axis += normals.back();
+                }
+            }
+
+            // A cutoff of 1 never passes the backface test, which is what a degenerate cone needs.
+            meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+            meshlet.coneCutoff = 1.0f;
+            float axisLength = glm::length(axis);
+            if (axisLength == 0.0f)
+            {
+                return meshlet;
+            }
+            axis /= axisLength;
+
+            float minDot = 1.0f;
+            for (const glm::vec3 &normal : normals)
+            {
+                minDot = std::min(minDot, glm::dot(axis, normal));
+            }
+            meshlet.coneAxis = axis;
+            if (minDot > 0.0f)
+            {
+                meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+            }
+            return meshlet;
+        }
+
+        void build(Mesh &mesh)
+        {
+            mesh.meshlets.clear();
+            const std::vector<uint32_t> &indices = mesh.indices;
+            size_t numVertices = mesh.vertices.size();
+            size_t numTriangles = indices.size() / 3;
+            if (numTriangles == 0)
+            {
+                return;
+            }
+
+            // Triangles adjacent to each vertex.
+            std::vector<uint32_t> offsets(numVertices + 1, 0);
+            for (uint32_t index : indices)
+            {
+                offsets[index + 1]++;
+            }
+            for (size_t v = 0; v < numVertices; v++)
+            {
+                offsets[v + 1] += offsets[v];
+            }
+            std::vector<uint32_t> adjacency(indices.size());
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t t = 0; t < numTriangles; t++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    adjacency[fill[indices[3 * t + k]]++] = static_cast<uint32_t>(t);
+                }
+            }
+
+            std::vector<uint8_t> emitted(numTriangles, 0);
+            // Id of the meshlet a vertex was last added to, so membership checks are O(1).
+            std::vector<uint32_t> vertexMeshlet(numVertices, NO_MESHLET);
+            std::vector<uint32_t> meshletVertices;
+            meshletVertices.reserve(MAX_VERTICES);
+            std::vector<uint32_t> result;
+            result.reserve(indices.size());
+            size_t cursor = 0;
+
+            auto newVertexCount = [&](uint32_t t, uint32_t meshletId) {
+                uint32_t count = 0;
+                for (int k = 0; k < 3; k++)
+                {
+                    count += vertexMeshlet[indices[3 * t + k]] != meshletId;
+                }
+                return count;
+            };
+
+            // The unemitted triangle around the meshlet's vertices that adds the fewest new vertices.
+            auto findAdjacent = [&](uint32_t meshletId) {
+                uint32_t best = NO_TRIANGLE;
+                uint32_t bestCost = 4;
+                for (uint32_t v : meshletVertices)
+                {
+                    for (uint32_t a = offsets[v]; a < offsets[v + 1]; a++)
+                    {
+                        uint32_t t = adjacency[a];
+                        if (emitted[t])
+                        {
+                            continue;
+                        }
+                        uint32_t cost = newVertexCount(t, meshletId);
+                        if (cost < bestCost)
+                        {
+                            best = t;
+                            bestCost = cost;
+                        }
+                    }
+                }
+                return best;
+            };
+
+            uint32_t meshletId = 0;
+            size_t emittedCount = 0;
+            uint32_t seed = 0;
+            while (emittedCount < numTriangles)
+            {
+                uint32_t firstIndex = static_cast<uint32_t>(result.size());
+                uint32_t triangleCount = 0;
+                meshletVertices.clear();
+
+                uint32_t t = seed;
+                while (t != NO_TRIANGLE)
+                {
+                    if (meshletVertices.size() + newVertexCount(t, meshletId) > MAX_VERTICES)
+                    {
+                        break;
+                    }
+                    for (int k = 0; k < 3; k++)
+                    {
+                        uint32_t v = indices[3 * t + k];
+                        if (vertexMeshlet[v] != meshletId)
+                        {
+                            vertexMeshlet[v] = meshletId;
+                            meshletVertices.push_back(v);
+                        }
+                        result.push_back(v);
+                    }
+                    emitted[t] = 1;
+                    emittedCount++;
+                    if (++triangleCount == MAX_TRIANGLES)
+                    {
+                        break;
+                    }
+                    t = findAdjacent(meshletId);
+                }
+
+                mesh.meshlets.push_back(computeBounds(mesh.vertices, result, firstIndex, static_cast<uint32_t>(result.size()) - firstIndex));
+
+                // Continue next to the meshlet just closed, or at the first triangle left in input order.
+                seed = NO_TRIANGLE;
+                for (size_t i = 0; i < meshletVertices.size() && seed == NO_TRIANGLE; i++)
+                {
+                    uint32_t v = meshletVertices[i];
+                    for (uint32_t a = offsets[v]; a < offsets[v + 1] && seed == NO_TRIANGLE; a++)
+                    {
+                        if (!emitted[adjacency[a]])
+                        {
+                            seed = adjacency[a];
+                        }
+                    }
+                }
+                while (seed == NO_TRIANGLE && cursor < numTriangles)
+                {
+                    if (!emitted[cursor])
+                    {
+                        seed = static_cast<uint32_t>(cursor);
+                    }
+                    cursor++;
+                }
+                meshletId++;
+            }
+
+            mesh.indices.swap(result);
+        }
+    }
+}
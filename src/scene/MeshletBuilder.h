@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Mesh.h"
+
+namespace mcvkp
+{
+    namespace MeshletBuilder
+    {
+        const uint32_t MAX_VERTICES = 64;
+        const uint32_t MAX_TRIANGLES = 124;
+
+        /**
+         * Splits the mesh into meshlets of at most MAX_VERTICES vertices and MAX_TRIANGLES triangles.
+         * Meshlets are grown greedily over shared vertices so they stay spatially compact. The index
+         * buffer is rewritten so every meshlet is one contiguous range, in meshlet order.
+         */
+        void build(Mesh &mesh);
+
+        // Bounding sphere and normal cone of the triangles in indices[firstIndex, firstIndex + indexCount).
+        Meshlet computeBounds(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+                              uint32_t firstIndex, uint32_t indexCount);
+    }
+}
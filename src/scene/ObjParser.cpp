@@ -0,0 +1,488 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "../utils/MappedFile.h"
+#include "../utils/ThreadPool.h"
+#include "ObjParser.h"
+
+namespace mcvkp
+{
+    namespace ObjParser
+    {
+        namespace
+        {
+            // Files smaller than this are not worth splitting across threads.
+            const size_t MIN_CHUNK_SIZE = 1 << 20;
+            // More chunks than threads so a chunk full of faces does not hold everyone up.
+            const size_t CHUNKS_PER_THREAD = 4;
+
+            enum class Record
+            {
+                eOther,
+                ePosition,
+                eNormal,
+                eTexcoord,
+                eFace
+            };
+
+            struct RecordCounts
+            {
+                size_t positions = 0;
+                size_t normals = 0;
+                size_t texcoords = 0;
+                size_t faces = 0;
+            };
+
+            inline bool isSpace(char c) { return c == ' ' || c == '\t'; }
+            inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+            /**
+             * tinyobjloader's tryParseDouble, kept operation for operation. The mantissa is built
+             * digit by digit and scaled with pow/ldexp, which is not always the correctly rounded
+             * value std::strtod would give, so any "better" parser here breaks the bit-exact match.
+             */
+            bool tryParseDouble(const char *s, const char *s_end, double *result)
+            {
+                if (s >= s_end)
+                {
+                    return false;
+                }
+
+                double mantissa = 0.0;
+                int exponent = 0;
+                char sign = '+';
+                char exp_sign = '+';
+                const char *curr = s;
+                int read = 0;
+                bool end_not_reached = false;
+                bool leading_decimal_dots = false;
+
+                if (*curr == '+' || *curr == '-')
+                {
+                    sign = *curr;
+                    curr++;
+                    if ((curr != s_end) && (*curr == '.'))
+                    {
+                        leading_decimal_dots = true;
+                    }
+                }
+                else if (isDigit(*curr))
+                {
+                }
+                else if (*curr == '.')
+                {
+                    leading_decimal_dots = true;
+                }
+                else
+                {
+                    return false;
+                }
+
+                // Integer part.
+                end_not_reached = (curr != s_end);
+                if (!leading_decimal_dots)
+                {
+                    while (end_not_reached && isDigit(*curr))
+                    {
+                        mantissa *= 10;
+                        mantissa += static_cast<int>(*curr - 0x30);
+                        curr++;
+                        read++;
+                        end_not_reached = (curr != s_end);
+                    }
+                    if (read == 0)
+                    {
+                        return false;
+                    }
+                }
+
+                if (!end_not_reached)
+                {
+                    goto assemble;
+                }
+
+                // Decimal part.
+                if (*curr == '.')
+                {
+                    curr++;
+                    read = 1;
+                    end_not_reached = (curr != s_end);
+                    while (end_not_reached && isDigit(*curr))
+                    {
+                        static const double pow_lut[] = {
+                            1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001,
+                        };
+                        const int lut_entries = sizeof pow_lut / sizeof pow_lut[0];
+
+                        mantissa += static_cast<int>(*curr - 0x30) *
+                                    (read < lut_entries ? pow_lut[read] : std::pow(10.0, -read));
+                        read++;
+                        curr++;
+                        end_not_reached = (curr != s_end);
+                    }
+                }
+                else if (*curr == 'e' || *curr == 'E')
+                {
+                }
+                else
+                {
+                    goto assemble;
+                }
+
+                if (!end_not_reached)
+                {
+                    goto assemble;
+                }
+
+                // Exponent part.
+                if (*curr == 'e' || *curr == 'E')
+                {
+                    curr++;
+                    end_not_reached = (curr != s_end);
+                    if (end_not_reached && (*curr == '+' || *curr == '-'))
+                    {
+                        exp_sign = *curr;
+                        curr++;
+                    }
+                    else if (end_not_reached && isDigit(*curr))
+                    {
+                    }
+                    else
+                    {
+                        return false;
+                    }
+
+                    read = 0;
+                    end_not_reached = (curr != s_end);
+                    while (end_not_reached && isDigit(*curr))
+                    {
+                        if (exponent > (2147483647 / 10))
+                        {
+                            return false;
+                        }
+                        exponent *= 10;
+                        exponent += static_cast<int>(*curr - 0x30);
+                        curr++;
+                        read++;
+                        end_not_reached = (curr != s_end);
+                    }
+                    exponent *= (exp_sign == '+' ? 1 : -1);
+                    if (read == 0)
+                    {
+                        return false;
+                    }
+                }
+
+            assemble:
+                *result = (sign == '+' ? 1 : -1) *
+                          (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+                return true;
+            }
+
+            // tinyobj's parseReal: a token runs up to the next blank, parse failures yield 0.
+            float parseReal(const char *&token, const char *lineEnd)
+            {
+                while (token < lineEnd && isSpace(*token))
+                {
+                    token++;
+                }
+                const char *end = token;
+                while (end < lineEnd && !isSpace(*end) && *end != '\r')
+                {
+                    end++;
+                }
+                double value = 0.0;
+                tryParseDouble(token, end, &value);
+                token = end;
+                return static_cast<float>(value);
+            }
+
+            // atoi() on the token, then skip to the next separator, like tinyobj's parseTriple.
+            int parseInt(const char *&token, const char *lineEnd)
+            {
+                const char *p = token;
+                while (p < lineEnd && (isSpace(*p) || *p == '\r' || *p == '\v' || *p == '\f'))
+                {
+                    p++;
+                }
+                bool negative = false;
+                if (p < lineEnd && (*p == '+' || *p == '-'))
+                {
+                    negative = *p == '-';
+                    p++;
+                }
+                long long value = 0;
+                while (p < lineEnd && isDigit(*p) && value <= 2147483647)
+                {
+                    value = value * 10 + (*p - '0');
+                    p++;
+                }
+                while (token < lineEnd && *token != '/' && !isSpace(*token) && *token != '\r')
+                {
+                    token++;
+                }
+                if (value > 2147483647)
+                {
+                    return 0;
+                }
+                return static_cast<int>(negative ? -value : value);
+            }
+
+            // Resolves a one-based or negative relative OBJ index. Zero is not a valid index.
+            bool fixIndex(int index, size_t count, int &result)
+            {
+                if (index > 0)
+                {
+                    result = index - 1;
+                    return true;
+                }
+                if (index < 0 && static_cast<size_t>(-static_cast<long long>(index)) <= count)
+                {
+                    result = static_cast<int>(count) + index;
+                    return true;
+                }
+                return false;
+            }
+
+            // Parses one v/vt/vn corner. Corners missing a texture coordinate or a normal are rejected.
+            bool parseCorner(const char *&token, const char *lineEnd, const RecordCounts &seen, ObjIndex &index)
+            {
+                if (!fixIndex(parseInt(token, lineEnd), seen.positions, index.vertex))
+                {
+                    return false;
+                }
+                if (token >= lineEnd || *token != '/')
+                {
+                    return false;
+                }
+                token++;
+                if (!fixIndex(parseInt(token, lineEnd), seen.texcoords, index.texcoord))
+                {
+                    return false;
+                }
+                if (token >= lineEnd || *token != '/')
+                {
+                    return false;
+                }
+                token++;
+                return fixIndex(parseInt(token, lineEnd), seen.normals, index.normal);
+            }
+
+            const char *findLineEnd(const char *p, const char *end)
+            {
+                while (p < end && *p != '\n' && *p != '\r')
+                {
+                    p++;
+                }
+                return p;
+            }
+
+            // Identifies the record on a line and moves token past its keyword.
+            Record classify(const char *&token, const char *lineEnd)
+            {
+                while (token < lineEnd && isSpace(*token))
+                {
+                    token++;
+                }
+                size_t length = lineEnd - token;
+                if (length >= 2 && token[0] == 'v' && isSpace(token[1]))
+                {
+                    token += 2;
+                    return Record::ePosition;
+                }
+                if (length >= 3 && token[0] == 'v' && token[1] == 'n' && isSpace(token[2]))
+                {
+                    token += 3;
+                    return Record::eNormal;
+                }
+                if (length >= 3 && token[0] == 'v' && token[1] == 't' && isSpace(token[2]))
+                {
+                    token += 3;
+                    return Record::eTexcoord;
+                }
+                if (length >= 2 && token[0] == 'f' && isSpace(token[1]))
+                {
+                    token += 2;
+                    return Record::eFace;
+                }
+                return Record::eOther;
+            }
+
+            RecordCounts countRecords(const char *begin, const char *end)
+            {
+                RecordCounts counts;
+                for (const char *line = begin; line < end;)
+                {
+                    const char *lineEnd = findLineEnd(line, end);
+                    const char *token = line;
+                    switch (classify(token, lineEnd))
+                    {
+                    case Record::ePosition:
+                        counts.positions++;
+                        break;
+                    case Record::eNormal:
+                        counts.normals++;
+                        break;
+                    case Record::eTexcoord:
+                        counts.texcoords++;
+                        break;
+                    case Record::eFace:
+                        counts.faces++;
+                        break;
+                    default:
+                        break;
+                    }
+                    line = lineEnd < end ? lineEnd + 1 : end;
+                }
+                return counts;
+            }
+
+            // Parses one chunk, writing into the shared arrays starting at the chunk's offsets.
+            bool parseChunk(const char *begin, const char *end, RecordCounts seen, const RecordCounts &totals, ObjData &data)
+            {
+                for (const char *line = begin; line < end;)
+                {
+                    const char *lineEnd = findLineEnd(line, end);
+                    const char *token = line;
+                    switch (classify(token, lineEnd))
+                    {
+                    case Record::ePosition:
+                    {
+                        float *position = &data.positions[3 * seen.positions++];
+                        position[0] = parseReal(token, lineEnd);
+                        position[1] = parseReal(token, lineEnd);
+                        position[2] = parseReal(token, lineEnd);
+                        break;
+                    }
+                    case Record::eNormal:
+                    {
+                        float *normal = &data.normals[3 * seen.normals++];
+                        normal[0] = parseReal(token, lineEnd);
+                        normal[1] = parseReal(token, lineEnd);
+                        normal[2] = parseReal(token, lineEnd);
+                        break;
+                    }
+                    case Record::eTexcoord:
+                    {
+                        float *texcoord = &data.texcoords[2 * seen.texcoords++];
+                        texcoord[0] = parseReal(token, lineEnd);
+                        texcoord[1] = parseReal(token, lineEnd);
+                        break;
+                    }
+                    case Record::eFace:
+                    {
+                        ObjIndex *corners = &data.indices[3 * seen.faces++];
+                        size_t numCorners = 0;
+                        while (token < lineEnd && isSpace(*token))
+                        {
+                            token++;
+                        }
+                        while (token < lineEnd)
+                        {
+                            ObjIndex corner;
+                            if (numCorners == 3 || !parseCorner(token, lineEnd, seen, corner))
+                            {
+                                return false;
+                            }
+                            if (corner.vertex >= static_cast<int>(totals.positions) ||
+                                corner.texcoord >= static_cast<int>(totals.texcoords) ||
+                                corner.normal >= static_cast<int>(totals.normals))
+                            {
+                                return false;
+                            }
+                            corners[numCorners++] = corner;
+                            while (token < lineEnd && (isSpace(*token) || *token == '\r'))
+                            {
+                                token++;
+                            }
+                        }
+                        if (numCorners != 3)
+                        {
+                            return false;
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                    }
+                    line = lineEnd < end ? lineEnd + 1 : end;
+                }
+                return true;
+            }
+        }
+
+        bool parse(const std::string &path, ObjData &data)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            MappedFile file(path);
+            if (!file.isOpen())
+            {
+                return false;
+            }
+            const char *begin = file.data();
+            const char *end = begin + file.size();
+
+            ThreadPool &pool = ThreadPool::shared();
+            size_t numChunks = std::max<size_t>(1, std::min(pool.size() * CHUNKS_PER_THREAD, file.size() / MIN_CHUNK_SIZE));
+
+            // Cut the file into roughly equal chunks, moving each cut forward to the next line start.
+            std::vector<const char *> bounds(numChunks + 1, end);
+            bounds[0] = begin;
+            for (size_t i = 1; i < numChunks; i++)
+            {
+                const char *cut = std::max(begin + file.size() / numChunks * i, bounds[i - 1]);
+                const char *newline = static_cast<const char *>(memchr(cut, '\n', end - cut));
+                bounds[i] = newline != nullptr ? newline + 1 : end;
+            }
+
+            // First pass counts records so every chunk knows where its output starts
+            // and what relative indices refer to.
+            std::vector<RecordCounts> offsets(numChunks);
+            pool.parallelFor(numChunks, [&](size_t i) {
+                offsets[i] = countRecords(bounds[i], bounds[i + 1]);
+            });
+
+            RecordCounts totals;
+            for (auto &chunk : offsets)
+            {
+                RecordCounts count = chunk;
+                chunk = totals;
+                totals.positions += count.positions;
+                totals.normals += count.normals;
+                totals.texcoords += count.texcoords;
+                totals.faces += count.faces;
+            }
+
+            data.positions.resize(3 * totals.positions);
+            data.normals.resize(3 * totals.normals);
+            data.texcoords.resize(2 * totals.texcoords);
+            data.indices.resize(3 * totals.faces);
+
+            std::atomic<bool> supported{true};
+            pool.parallelFor(numChunks, [&](size_t i) {
+                if (!parseChunk(bounds[i], bounds[i + 1], offsets[i], totals, data))
+                {
+                    supported = false;
+                }
+            });
+
+            if (!supported)
+            {
+                data = ObjData();
+                return false;
+            }
+
+            auto finish = std::chrono::high_resolution_clock::now();
+            double seconds = std::chrono::duration<double>(finish - start).count();
+            double megabytes = file.size() / (1024.0 * 1024.0);
+            std::cout << "Parsed " << path << ": " << megabytes << " MB in " << seconds * 1000.0 << " ms ("
+                      << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s, " << std::min(numChunks, pool.size() + 1) << " threads)"
+                      << "\n";
+            return true;
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace mcvkp
+{
+    // Zero-based attribute indices of one face corner, -1 if the corner has no such attribute.
+    struct ObjIndex
+    {
+        int vertex;
+        int normal;
+        int texcoord;
+    };
+
+    // Raw OBJ geometry: flat attribute arrays plus three corners per triangle, in file order.
+    struct ObjData
+    {
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> texcoords;
+        std::vector<ObjIndex> indices;
+    };
+
+    namespace ObjParser
+    {
+        /**
+         * Memory-maps the file and parses v/vn/vt/f records on the shared thread pool.
+         *
+         * Floats go through the same arithmetic as tinyobjloader, so the output matches
+         * tinyobj::LoadObj bit for bit. Returns false for files the fast path does not handle
+         * (non-triangle faces, corners without normals or texture coordinates, bad indices);
+         * callers fall back to tinyobj for those.
+         */
+        bool parse(const std::string &path, ObjData &data);
+    }
+}
@@ -0,0 +1,59 @@
+#include <stdexcept>
+#include "ObjectStore.h"
+
+namespace mcvkp
+{
+    ObjectStore::ObjectStore(size_t numFrames, uint32_t capacity) : m_capacity(capacity), m_objectCount(0)
+    {
+        m_bufferBundle = std::make_shared<BufferBundle>(numFrames);
+        for (const std::shared_ptr<Buffer> &buffer : m_bufferBundle->buffers)
+        {
+            BufferUtils::allocate(buffer.get(), m_capacity * sizeof(ObjectData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                  VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT, MemoryCategory::eUniform);
+            // The descriptor covers the whole array.
+            buffer->size = m_capacity * sizeof(ObjectData);
+
+            VmaAllocationInfo allocationInfo;
+            vmaGetAllocationInfo(VulkanGlobal::context.getAllocator(), buffer->allocation, &allocationInfo);
+            m_mappedFrames.push_back(static_cast<ObjectData *>(allocationInfo.pMappedData));
+        }
+    }
+
+    uint32_t ObjectStore::add(const glm::mat4 &model)
+    {
+        if (m_objectCount == m_capacity)
+        {
+            throw std::runtime_error("object store is full!");
+        }
+        uint32_t objectId = m_objectCount++;
+        for (size_t frame = 0; frame < m_mappedFrames.size(); frame++)
+        {
+            update(objectId, model, frame);
+            flush(frame);
+        }
+        return objectId;
+    }
+
+    void ObjectStore::update(uint32_t objectId, const glm::mat4 &model, size_t frame)
+    {
+        ObjectData &object = m_mappedFrames[frame][objectId];
+        object.model = model;
+        object.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(model))));
+    }
+
+    void ObjectStore::flush(size_t frame)
+    {
+        vmaFlushAllocation(VulkanGlobal::context.getAllocator(), m_bufferBundle->buffers[frame]->allocation,
+                           0, m_objectCount * sizeof(ObjectData));
+    }
+
+    const std::shared_ptr<BufferBundle> &ObjectStore::getBufferBundle() const
+    {
+        return m_bufferBundle;
+    }
+
+    uint32_t ObjectStore::getObjectCount() const
+    {
+        return m_objectCount;
+    }
+}
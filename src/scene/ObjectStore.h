@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "../utils/glm.h"
+#include "../memory/Buffer.h"
+#include "Mesh.h"
+
+namespace mcvkp
+{
+    /**
+     * Transforms of every object, packed into one persistently mapped storage buffer per frame.
+     * Shaders index it with the objectId push constant, so objects need no descriptor sets of
+     * their own and updating one is a write into a contiguous array.
+     */
+    class ObjectStore
+    {
+    public:
+        ObjectStore(size_t numFrames, uint32_t capacity = 1024);
+
+        // Returns the new object's id. The transform is written to every frame.
+        uint32_t add(const glm::mat4 &model);
+
+        // Only touch a frame the GPU is done with.
+        void update(uint32_t objectId, const glm::mat4 &model, size_t frame);
+
+        void flush(size_t frame);
+
+        const std::shared_ptr<BufferBundle> &getBufferBundle() const;
+
+        uint32_t getObjectCount() const;
+
+    private:
+        std::shared_ptr<BufferBundle> m_bufferBundle;
+        std::vector<ObjectData *> m_mappedFrames;
+        uint32_t m_capacity;
+        uint32_t m_objectCount;
+    };
+}
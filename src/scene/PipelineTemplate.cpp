@@ -0,0 +1,350 @@
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "../utils/readfile.h"
+#include "../utils/Hash.h"
+#include "../app-context/VulkanApplicationContext.h"
+#include "../app-context/DeletionQueue.h"
+#include "../render-context/PipelineCache.h"
+#include "../render-context/DescriptorLayoutCache.h"
+#include "../utils/ThreadPool.h"
+#include "PipelineTemplate.h"
+
+namespace mcvkp
+{
+    namespace
+    {
+        struct Entry
+        {
+            PipelineTemplate::Key key;
+            std::weak_ptr<PipelineTemplate> live;
+            // Valid while the template is being built.
+            PipelineTemplate::Future pending;
+        };
+
+        struct Registry
+        {
+            std::mutex mutex;
+            std::unordered_map<uint64_t, Entry> templates;
+            size_t liveCount = 0;
+        };
+
+        PipelineTemplate::Future makeReady(const std::shared_ptr<PipelineTemplate> &pipelineTemplate)
+        {
+            std::promise<std::shared_ptr<PipelineTemplate> > promise;
+            promise.set_value(pipelineTemplate);
+            return promise.get_future().share();
+        }
+
+        Registry &registry()
+        {
+            // Never destroyed: templates can outlive function-local statics through the deletion queue.
+            static Registry *instance = new Registry();
+            return *instance;
+        }
+    }
+
+    bool PipelineTemplate::Key::operator==(const Key &other) const
+    {
+        if (vertexShaderHash != other.vertexShaderHash || fragmentShaderHash != other.fragmentShaderHash ||
+            vertexFormat != other.vertexFormat || renderPass != other.renderPass ||
+            extent.width != other.extent.width || extent.height != other.extent.height)
+        {
+            return false;
+        }
+        // The layout cache makes equal bindings the same layout.
+        return setLayouts == other.setLayouts;
+    }
+
+    uint64_t PipelineTemplate::Key::hash() const
+    {
+        std::vector<uint64_t> words = {vertexShaderHash,
+                                       fragmentShaderHash,
+                                       static_cast<uint64_t>(vertexFormat),
+                                       reinterpret_cast<uint64_t>(renderPass),
+                                       (static_cast<uint64_t>(extent.width) << 32) | extent.height};
+        for (VkDescriptorSetLayout setLayout : setLayouts)
+        {
+            words.push_back(reinterpret_cast<uint64_t>(setLayout));
+        }
+        return Hash::words(words.data(), words.size());
+    }
+
+    PipelineTemplate::Future PipelineTemplate::acquireAsync(const PipelineDescription &description)
+    {
+        std::vector<char> vertexShaderCode = readFile(description.vertexShaderPath);
+        std::vector<char> fragmentShaderCode = readFile(description.fragmentShaderPath);
+
+        Key key;
+        key.vertexShaderHash = Hash::fnv1a(vertexShaderCode.data(), vertexShaderCode.size());
+        key.fragmentShaderHash = Hash::fnv1a(fragmentShaderCode.data(), fragmentShaderCode.size());
+        key.vertexFormat = description.vertexFormat;
+        for (const std::vector<VkDescriptorSetLayoutBinding> &bindings : description.setBindings)
+        {
+            key.setLayouts.push_back(DescriptorLayoutCache::shared()->getLayout(bindings));
+        }
+        key.renderPass = description.renderPass;
+        key.extent = description.extent;
+        uint64_t hash = key.hash();
+
+        // Anything released while the lock is held must not be the last reference to a template,
+        // whose destructor takes the lock too. Replaced entries are moved out here first.
+        Entry replaced;
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        auto it = registry().templates.find(hash);
+        if (it != registry().templates.end() && it->second.key == key)
+        {
+            std::shared_ptr<PipelineTemplate> live = it->second.live.lock();
+            if (live != nullptr)
+            {
+                return makeReady(live);
+            }
+            if (it->second.pending.valid())
+            {
+                return it->second.pending;
+            }
+        }
+
+        Future future = ThreadPool::shared().submit([key, hash, vertexShaderCode, fragmentShaderCode]()
+                                                    {
+                                                        std::shared_ptr<PipelineTemplate> pipelineTemplate(new PipelineTemplate(key, vertexShaderCode, fragmentShaderCode));
+
+                                                        Future finished;
+                                                        std::lock_guard<std::mutex> lock(registry().mutex);
+                                                        auto it = registry().templates.find(hash);
+                                                        if (it != registry().templates.end() && it->second.key == key)
+                                                        {
+                                                            it->second.live = pipelineTemplate;
+                                                            finished = std::move(it->second.pending);
+                                                        }
+                                                        return pipelineTemplate; })
+                            .share();
+
+        // A hash collision with a live or building template just leaves the new one unshared.
+        bool occupied = it != registry().templates.end() && !(it->second.key == key) &&
+                        (!it->second.live.expired() || it->second.pending.valid());
+        if (!occupied)
+        {
+            Entry &entry = registry().templates[hash];
+            replaced = std::move(entry);
+            entry = {key, {}, future};
+        }
+        return future;
+    }
+
+    std::shared_ptr<PipelineTemplate> PipelineTemplate::acquire(const PipelineDescription &description)
+    {
+        return acquireAsync(description).get();
+    }
+
+    size_t PipelineTemplate::getLiveCount()
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        return registry().liveCount;
+    }
+
+    PipelineTemplate::PipelineTemplate(const Key &key, const std::vector<char> &vertexShaderCode, const std::vector<char> &fragmentShaderCode)
+        : m_key(key), m_layoutCache(DescriptorLayoutCache::shared())
+    {
+        __initPipeline(vertexShaderCode, fragmentShaderCode);
+
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().liveCount++;
+    }
+
+    PipelineTemplate::~PipelineTemplate()
+    {
+        {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            registry().liveCount--;
+        }
+
+        // The descriptor set layouts belong to the cache, kept alive until the pipeline layout using them is gone.
+        std::shared_ptr<DescriptorLayoutCache> layoutCache = m_layoutCache;
+        VkPipeline pipeline = m_pipeline;
+        VkPipelineLayout pipelineLayout = m_pipelineLayout;
+        VulkanGlobal::deletionQueue.push([layoutCache, pipeline, pipelineLayout]()
+                                         {
+                                             vkDestroyPipeline(VulkanGlobal::context.getDevice(), pipeline, nullptr);
+                                             vkDestroyPipelineLayout(VulkanGlobal::context.getDevice(), pipelineLayout, nullptr); });
+    }
+
+    VkShaderModule PipelineTemplate::__createShaderModule(const std::vector<char> &code)
+    {
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = code.size();
+        createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(VulkanGlobal::context.getDevice(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create shader module!");
+        }
+        return shaderModule;
+    }
+
+    void PipelineTemplate::__initPipeline(const std::vector<char> &vertShaderCode, const std::vector<char> &fragShaderCode)
+    {
+        VkShaderModule vertShaderModule = __createShaderModule(vertShaderCode);
+        VkShaderModule fragShaderModule = __createShaderModule(fragShaderCode);
+
+        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vertShaderStageInfo.module = vertShaderModule;
+        vertShaderStageInfo.pName = "main";
+
+        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        fragShaderStageInfo.module = fragShaderModule;
+        fragShaderStageInfo.pName = "main";
+
+        VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = 0;
+        vertexInputInfo.pVertexBindingDescriptions = nullptr; // Optional
+        vertexInputInfo.vertexAttributeDescriptionCount = 0;
+        vertexInputInfo.pVertexAttributeDescriptions = nullptr; // Optional
+        bool compact = m_key.vertexFormat == VertexFormat::eCompact;
+        auto bindingDescription = compact ? CompactVertex::getBindingDescription() : Vertex::getBindingDescription();
+        auto attributeDescriptions = compact ? CompactVertex::getAttributeDescriptions() : Vertex::getAttributeDescriptions();
+
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float)m_key.extent.width;
+        viewport.height = (float)m_key.extent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        VkRect2D scissor{};
+        scissor.offset = {0, 0};
+        scissor.extent = m_key.extent;
+
+        VkPipelineViewportStateCreateInfo viewportState{};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.pViewports = &viewport;
+        viewportState.scissorCount = 1;
+        viewportState.pScissors = &scissor;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.depthClampEnable = VK_FALSE;
+        rasterizer.rasterizerDiscardEnable = VK_FALSE;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rasterizer.depthBiasEnable = VK_FALSE;
+        rasterizer.depthBiasConstantFactor = 0.0f; // Optional
+        rasterizer.depthBiasClamp = 0.0f;          // Optional
+        rasterizer.depthBiasSlopeFactor = 0.0f;    // Optional
+
+        VkPipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.sampleShadingEnable = VK_FALSE;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        multisampling.minSampleShading = .2f;           // min fraction for sample shading; closer to one is smoother
+        multisampling.pSampleMask = nullptr;            // Optional
+        multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
+        multisampling.alphaToOneEnable = VK_FALSE;      // Optional
+
+        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_FALSE;
+
+        VkPipelineColorBlendStateCreateInfo colorBlending{};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.logicOpEnable = VK_FALSE;
+        colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &colorBlendAttachment;
+        colorBlending.blendConstants[0] = 0.0f; // Optional
+        colorBlending.blendConstants[1] = 0.0f; // Optional
+        colorBlending.blendConstants[2] = 0.0f; // Optional
+        colorBlending.blendConstants[3] = 0.0f; // Optional
+
+        VkDynamicState dynamicStates[] = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_LINE_WIDTH};
+
+        VkPipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(m_key.setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = m_key.setLayouts.data();
+
+        // Every model pushes its object id, and compact ones the transform that dequantizes their vertices.
+        // The range is the same for all templates, which keeps their layouts compatible for set 0.
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(DrawPushConstants);
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(VulkanGlobal::context.getDevice(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        VkPipelineDepthStencilStateCreateInfo depthStencil{};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = VK_TRUE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        depthStencil.depthBoundsTestEnable = VK_FALSE;
+        depthStencil.minDepthBounds = 0.0f; // Optional
+        depthStencil.maxDepthBounds = 1.0f; // Optional
+        depthStencil.stencilTestEnable = VK_FALSE;
+        depthStencil.front = {}; // Optional
+        depthStencil.back = {};  // Optional
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = nullptr; // Optional
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = nullptr; // Optional
+        pipelineInfo.layout = m_pipelineLayout;
+        pipelineInfo.renderPass = m_key.renderPass;
+        pipelineInfo.subpass = 0;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+        pipelineInfo.basePipelineIndex = -1;              // Optional
+        pipelineInfo.pDepthStencilState = &depthStencil;
+
+        if (PipelineCache::createGraphicsPipeline(pipelineInfo, &m_pipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create graphics pipeline!");
+        }
+
+        vkDestroyShaderModule(VulkanGlobal::context.getDevice(), fragShaderModule, nullptr);
+        vkDestroyShaderModule(VulkanGlobal::context.getDevice(), vertShaderModule, nullptr);
+    }
+}
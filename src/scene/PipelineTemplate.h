@@ -0,0 +1,84 @@
+#pragma once
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "Mesh.h"
+#include "../render-context/DescriptorLayoutCache.h"
+
+namespace mcvkp
+{
+    // Everything a graphics pipeline is built from. Materials describe themselves with it.
+    struct PipelineDescription
+    {
+        std::string vertexShaderPath;
+        std::string fragmentShaderPath;
+        VertexFormat vertexFormat = VertexFormat::eFull;
+        // The bindings of each descriptor set, indexed by set number. Sets may be empty.
+        std::vector<std::vector<VkDescriptorSetLayoutBinding> > setBindings;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkExtent2D extent = {0, 0};
+    };
+
+    /**
+     * The shader modules, pipeline layout and pipeline for one description.
+     * Templates are shared: materials with the same shader code (compared by content, not path),
+     * vertex format, bindings, render pass and extent get the same template, so a thousand textured
+     * objects make one pipeline. A template is destroyed with the last material holding it. Its
+     * descriptor set layouts come from DescriptorLayoutCache::shared() and outlive it.
+     *
+     * Templates are built on ThreadPool::shared(), so materials with different shaders compile
+     * in parallel. Do not wait on a template from inside a job of that pool.
+     */
+    class PipelineTemplate
+    {
+    public:
+        using Future = std::shared_future<std::shared_ptr<PipelineTemplate> >;
+
+        // The live or in-flight template matching the description, or a new build job. Thread-safe.
+        // Shader files are read on the calling thread; everything else happens on the pool.
+        static Future acquireAsync(const PipelineDescription &description);
+
+        // Same, but waits for the template.
+        static std::shared_ptr<PipelineTemplate> acquire(const PipelineDescription &description);
+
+        // Templates currently alive.
+        static size_t getLiveCount();
+
+        ~PipelineTemplate();
+
+        PipelineTemplate(const PipelineTemplate &) = delete;
+        PipelineTemplate &operator=(const PipelineTemplate &) = delete;
+
+        VkPipeline getPipeline() const { return m_pipeline; }
+        VkPipelineLayout getPipelineLayout() const { return m_pipelineLayout; }
+        VkDescriptorSetLayout getDescriptorSetLayout(uint32_t set) const { return m_key.setLayouts[set]; }
+
+        // What two descriptions must agree on to share a template.
+        struct Key
+        {
+            uint64_t vertexShaderHash;
+            uint64_t fragmentShaderHash;
+            VertexFormat vertexFormat;
+            std::vector<VkDescriptorSetLayout> setLayouts;
+            VkRenderPass renderPass;
+            VkExtent2D extent;
+
+            bool operator==(const Key &other) const;
+            uint64_t hash() const;
+        };
+
+    private:
+
+        PipelineTemplate(const Key &key, const std::vector<char> &vertexShaderCode, const std::vector<char> &fragmentShaderCode);
+
+        void __initPipeline(const std::vector<char> &vertexShaderCode, const std::vector<char> &fragmentShaderCode);
+        VkShaderModule __createShaderModule(const std::vector<char> &code);
+
+        Key m_key;
+        std::shared_ptr<DescriptorLayoutCache> m_layoutCache;
+        VkPipelineLayout m_pipelineLayout;
+        VkPipeline m_pipeline;
+    };
+}
@@ -0,0 +1,349 @@
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "ResourceBindings.h"
+#include "../app-context/VulkanApplicationContext.h"
+#include "../app-context/VulkanSwapchain.h"
+#include "../app-context/DeletionQueue.h"
+#include "../render-context/DescriptorLayoutCache.h"
+
+namespace mcvkp
+{
+    ResourceBindings::ResourceBindings()
+    {
+        m_numFrames = VulkanGlobal::swapchainContext.getImages().size();
+    }
+
+    ResourceBindings::~ResourceBindings()
+    {
+        if (m_descriptorAllocator != nullptr)
+        {
+            __retireDescriptorSets();
+        }
+    }
+
+    void ResourceBindings::addTexture(const std::shared_ptr<Texture> &texture, VkShaderStageFlags shaderStageFlags)
+    {
+        m_textureDescriptors.push_back({texture, shaderStageFlags});
+        m_perSetTextures.emplace_back();
+    }
+
+    void ResourceBindings::addTexture(const std::vector<std::shared_ptr<Texture> > &textures, VkShaderStageFlags shaderStageFlags)
+    {
+        if (textures.empty())
+        {
+            throw std::runtime_error("failed to add texture: no textures given!");
+        }
+        m_textureDescriptors.push_back({textures[0], shaderStageFlags});
+        m_perSetTextures.push_back(textures);
+    }
+
+    void ResourceBindings::addBufferBundle(const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags)
+    {
+        m_bufferBundleDescriptors.push_back({bufferBundle, shaderStageFlags});
+    }
+
+    void ResourceBindings::addDynamicUniform(const std::shared_ptr<UniformRingBuffer> &ring,
+                                             const UniformRingBuffer::Allocation &allocation,
+                                             VkShaderStageFlags shaderStageFlags)
+    {
+        if (ring->getNumFrames() != m_numFrames)
+        {
+            throw std::runtime_error("uniform ring needs one frame slot per descriptor set!");
+        }
+        m_dynamicUniformDescriptors.push_back({std::make_shared<DynamicUniform>(DynamicUniform{ring, allocation}), shaderStageFlags});
+        m_dynamicOffsets.push_back(allocation.offset);
+    }
+
+    void ResourceBindings::addStorageBufferBundle(const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags)
+    {
+        m_storageBufferDescriptors.push_back({bufferBundle, shaderStageFlags});
+    }
+
+    void ResourceBindings::addStorageImage(const std::shared_ptr<Image> &image, VkShaderStageFlags shaderStageFlags)
+    {
+        m_storageImageDescriptors.push_back({image, shaderStageFlags});
+    }
+
+    const std::vector<Descriptor<BufferBundle> > &ResourceBindings::getBufferBundles() const
+    {
+        return m_bufferBundleDescriptors;
+    }
+
+    const std::vector<Descriptor<Texture> > &ResourceBindings::getTextures() const
+    {
+        return m_textureDescriptors;
+    }
+
+    const std::vector<Descriptor<Image> > &ResourceBindings::getStorageImages() const
+    {
+        return m_storageImageDescriptors;
+    }
+
+    bool ResourceBindings::empty() const
+    {
+        return m_bufferBundleDescriptors.empty() && m_dynamicUniformDescriptors.empty() && m_storageBufferDescriptors.empty() &&
+               m_textureDescriptors.empty() && m_storageImageDescriptors.empty();
+    }
+
+    bool ResourceBindings::isFrameInvariant() const
+    {
+        if (!m_bufferBundleDescriptors.empty() || !m_dynamicUniformDescriptors.empty() || !m_storageBufferDescriptors.empty())
+        {
+            return false;
+        }
+        for (const std::vector<std::shared_ptr<Texture> > &perSetTextures : m_perSetTextures)
+        {
+            if (!perSetTextures.empty())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding> ResourceBindings::getLayoutBindings() const
+    {
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+        for (size_t buffer_i = 0; buffer_i < m_bufferBundleDescriptors.size(); buffer_i++)
+        {
+            VkDescriptorSetLayoutBinding uboLayoutBinding{};
+            uboLayoutBinding.binding = buffer_i;
+            uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            uboLayoutBinding.descriptorCount = 1;
+            uboLayoutBinding.stageFlags = m_bufferBundleDescriptors[buffer_i].shaderStageFlags;
+            uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+            bindings.push_back(uboLayoutBinding);
+        }
+
+        for (size_t dynamic_i = 0; dynamic_i < m_dynamicUniformDescriptors.size(); dynamic_i++)
+        {
+            VkDescriptorSetLayoutBinding uboLayoutBinding{};
+            uboLayoutBinding.binding = m_bufferBundleDescriptors.size() + dynamic_i;
+            uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            uboLayoutBinding.descriptorCount = 1;
+            uboLayoutBinding.stageFlags = m_dynamicUniformDescriptors[dynamic_i].shaderStageFlags;
+            uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+            bindings.push_back(uboLayoutBinding);
+        }
+
+        for (size_t storage_i = 0; storage_i < m_storageBufferDescriptors.size(); storage_i++)
+        {
+            VkDescriptorSetLayoutBinding storageLayoutBinding{};
+            storageLayoutBinding.binding = m_bufferBundleDescriptors.size() + m_dynamicUniformDescriptors.size() + storage_i;
+            storageLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            storageLayoutBinding.descriptorCount = 1;
+            storageLayoutBinding.stageFlags = m_storageBufferDescriptors[storage_i].shaderStageFlags;
+            storageLayoutBinding.pImmutableSamplers = nullptr; // Optional
+            bindings.push_back(storageLayoutBinding);
+        }
+
+        for (size_t tex_i = 0; tex_i < m_textureDescriptors.size(); tex_i++)
+        {
+            size_t binding = m_bufferBundleDescriptors.size() + m_dynamicUniformDescriptors.size() + m_storageBufferDescriptors.size() + tex_i;
+            VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+            samplerLayoutBinding.binding = binding;
+            samplerLayoutBinding.descriptorCount = 1;
+            samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            samplerLayoutBinding.pImmutableSamplers = nullptr;
+            samplerLayoutBinding.stageFlags = m_textureDescriptors[tex_i].shaderStageFlags;
+            bindings.push_back(samplerLayoutBinding);
+        }
+
+        for (size_t tex_i = 0; tex_i < m_storageImageDescriptors.size(); tex_i++)
+        {
+            size_t binding = m_bufferBundleDescriptors.size() + m_dynamicUniformDescriptors.size() + m_storageBufferDescriptors.size() +
+                             m_textureDescriptors.size() + tex_i;
+            VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+            samplerLayoutBinding.binding = binding;
+            samplerLayoutBinding.descriptorCount = 1;
+            samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            samplerLayoutBinding.pImmutableSamplers = nullptr;
+            samplerLayoutBinding.stageFlags = m_storageImageDescriptors[tex_i].shaderStageFlags;
+            bindings.push_back(samplerLayoutBinding);
+        }
+
+        return bindings;
+    }
+
+    void ResourceBindings::createDescriptorSets()
+    {
+        if (m_descriptorAllocator != nullptr)
+        {
+            return;
+        }
+        VkDescriptorSetLayout layout = DescriptorLayoutCache::shared()->getLayout(getLayoutBindings());
+        m_descriptorAllocator = DescriptorAllocator::shared();
+        m_descriptorSets = m_descriptorAllocator->allocate(layout, isFrameInvariant() ? 1 : m_numFrames);
+
+        __writeDescriptorSets();
+    }
+
+    bool ResourceBindings::hasDescriptorSets() const
+    {
+        return !m_descriptorSets.empty();
+    }
+
+    void ResourceBindings::updateDescriptorSets()
+    {
+        if (m_descriptorAllocator == nullptr)
+        {
+            return;
+        }
+        // Frames in flight may still read the current sets, so the new resources go into fresh ones.
+        __retireDescriptorSets();
+        VkDescriptorSetLayout layout = DescriptorLayoutCache::shared()->getLayout(getLayoutBindings());
+        m_descriptorSets = m_descriptorAllocator->allocate(layout, static_cast<uint32_t>(m_descriptorSets.size()));
+
+        __writeDescriptorSets();
+    }
+
+    VkDescriptorSet ResourceBindings::getDescriptorSet(size_t currentFrame) const
+    {
+        return m_descriptorSets[currentFrame % m_descriptorSets.size()];
+    }
+
+    const std::vector<uint32_t> &ResourceBindings::getDynamicOffsets() const
+    {
+        return m_dynamicOffsets;
+    }
+
+    void ResourceBindings::__retireDescriptorSets()
+    {
+        std::shared_ptr<DescriptorAllocator> descriptorAllocator = m_descriptorAllocator;
+        std::vector<VkDescriptorSet> descriptorSets = m_descriptorSets;
+        VulkanGlobal::deletionQueue.push([descriptorAllocator, descriptorSets]()
+                                         { descriptorAllocator->free(descriptorSets); });
+    }
+
+    void ResourceBindings::__writeDescriptorSets()
+    {
+        size_t numDescriptors = m_bufferBundleDescriptors.size() + m_dynamicUniformDescriptors.size() + m_storageBufferDescriptors.size() +
+                                m_textureDescriptors.size() + m_storageImageDescriptors.size();
+
+        for (size_t i = 0; i < m_descriptorSets.size(); i++)
+        {
+            // VkDescriptorBufferInfo bufferInfo = uniformBuffers[i].getDescriptorInfo();
+            // VkDescriptorImageInfo imageInfo = textureImage.getDescriptorInfo();
+            // VkDescriptorBufferInfo sharedBufferInfo = (*sharedUniformBuffers)[i].getDescriptorInfo();
+
+            std::vector<VkWriteDescriptorSet> descriptorWrites;
+            descriptorWrites.reserve(numDescriptors);
+            std::vector<VkDescriptorBufferInfo> bufferDescInfos;
+            for (size_t buffer_i = 0; buffer_i < m_bufferBundleDescriptors.size(); buffer_i++)
+            {
+                bufferDescInfos.push_back(m_bufferBundleDescriptors[buffer_i].data->buffers[i]->getDescriptorInfo());
+            }
+
+            for (size_t buffer_i = 0; buffer_i < m_bufferBundleDescriptors.size(); buffer_i++)
+            {
+                VkWriteDescriptorSet descriptorSet{};
+                descriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorSet.dstSet = m_descriptorSets[i];
+                descriptorSet.dstBinding = buffer_i;
+                descriptorSet.dstArrayElement = 0;
+                descriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                descriptorSet.descriptorCount = 1;
+                descriptorSet.pBufferInfo = &bufferDescInfos[buffer_i];
+
+                descriptorWrites.push_back(descriptorSet);
+            }
+
+            // The dynamic offset selects the allocation, the descriptor covers one allocation from the slot start.
+            std::vector<VkDescriptorBufferInfo> dynamicDescInfos;
+            for (size_t dynamic_i = 0; dynamic_i < m_dynamicUniformDescriptors.size(); dynamic_i++)
+            {
+                const DynamicUniform &uniform = *m_dynamicUniformDescriptors[dynamic_i].data;
+                VkDescriptorBufferInfo bufferInfo{};
+                bufferInfo.buffer = uniform.ring->getBufferBundle()->buffers[i]->buffer;
+                bufferInfo.offset = 0;
+                bufferInfo.range = uniform.allocation.size;
+                dynamicDescInfos.push_back(bufferInfo);
+            }
+
+            for (size_t dynamic_i = 0; dynamic_i < m_dynamicUniformDescriptors.size(); dynamic_i++)
+            {
+                VkWriteDescriptorSet descriptorSet{};
+                descriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorSet.dstSet = m_descriptorSets[i];
+                descriptorSet.dstBinding = m_bufferBundleDescriptors.size() + dynamic_i;
+                descriptorSet.dstArrayElement = 0;
+                descriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                descriptorSet.descriptorCount = 1;
+                descriptorSet.pBufferInfo = &dynamicDescInfos[dynamic_i];
+
+                descriptorWrites.push_back(descriptorSet);
+            }
+
+            std::vector<VkDescriptorBufferInfo> storageDescInfos;
+            for (size_t storage_i = 0; storage_i < m_storageBufferDescriptors.size(); storage_i++)
+            {
+                storageDescInfos.push_back(m_storageBufferDescriptors[storage_i].data->buffers[i]->getDescriptorInfo());
+            }
+
+            for (size_t storage_i = 0; storage_i < m_storageBufferDescriptors.size(); storage_i++)
+            {
+                VkWriteDescriptorSet descriptorSet{};
+                descriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorSet.dstSet = m_descriptorSets[i];
+                descriptorSet.dstBinding = m_bufferBundleDescriptors.size() + m_dynamicUniformDescriptors.size() + storage_i;
+                descriptorSet.dstArrayElement = 0;
+                descriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorSet.descriptorCount = 1;
+                descriptorSet.pBufferInfo = &storageDescInfos[storage_i];
+
+                descriptorWrites.push_back(descriptorSet);
+            }
+
+            std::vector<VkDescriptorImageInfo> imageInfos;
+            for (size_t tex_i = 0; tex_i < m_textureDescriptors.size(); tex_i++)
+            {
+                const std::vector<std::shared_ptr<Texture> > &perSetTextures = m_perSetTextures[tex_i];
+                const std::shared_ptr<Texture> &texture = perSetTextures.empty() ? m_textureDescriptors[tex_i].data
+                                                                                 : perSetTextures[i % perSetTextures.size()];
+                imageInfos.push_back(texture->getDescriptorInfo());
+            }
+
+            for (size_t tex_i = 0; tex_i < m_textureDescriptors.size(); tex_i++)
+            {
+                size_t binding = m_bufferBundleDescriptors.size() + m_dynamicUniformDescriptors.size() + m_storageBufferDescriptors.size() + tex_i;
+                VkWriteDescriptorSet descriptorSet{};
+                descriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorSet.dstSet = m_descriptorSets[i];
+                descriptorSet.dstBinding = binding;
+                descriptorSet.dstArrayElement = 0;
+                descriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptorSet.descriptorCount = 1;
+                descriptorSet.pImageInfo = &imageInfos[tex_i];
+
+                descriptorWrites.push_back(descriptorSet);
+            }
+
+            std::vector<VkDescriptorImageInfo> storageImageInfos;
+            for (size_t tex_i = 0; tex_i < m_storageImageDescriptors.size(); tex_i++)
+            {
+                storageImageInfos.push_back(m_storageImageDescriptors[tex_i].data->getDescriptorInfo(VK_IMAGE_LAYOUT_GENERAL));
+            }
+
+            for (size_t tex_i = 0; tex_i < m_storageImageDescriptors.size(); tex_i++)
+            {
+                size_t binding = m_bufferBundleDescriptors.size() + m_dynamicUniformDescriptors.size() + m_storageBufferDescriptors.size() +
+                                 m_textureDescriptors.size() + tex_i;
+                VkWriteDescriptorSet descriptorSet{};
+                descriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorSet.dstSet = m_descriptorSets[i];
+                descriptorSet.dstBinding = binding;
+                descriptorSet.dstArrayElement = 0;
+                descriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                descriptorSet.descriptorCount = 1;
+                descriptorSet.pImageInfo = &storageImageInfos[tex_i];
+
+                descriptorWrites.push_back(descriptorSet);
+            }
+
+            vkUpdateDescriptorSets(VulkanGlobal::context.getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+    }
+}
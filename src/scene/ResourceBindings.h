@@ -0,0 +1,109 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "../memory/Buffer.h"
+#include "../memory/Image.h"
+#include "../memory/UniformRingBuffer.h"
+#include "../utils/vulkan.h"
+#include "../render-context/DescriptorAllocator.h"
+
+namespace mcvkp
+{
+    template <typename T>
+    struct Descriptor
+    {
+        std::shared_ptr<T> data;
+        VkShaderStageFlags shaderStageFlags;
+    };
+
+    // A sub-allocation of a uniform ring, bound as a dynamic uniform buffer.
+    struct DynamicUniform
+    {
+        std::shared_ptr<UniformRingBuffer> ring;
+        UniformRingBuffer::Allocation allocation;
+    };
+
+    /**
+     * The resources of one descriptor set. Bindings are numbered in the order buffer bundles,
+     * dynamic uniforms, storage buffer bundles, textures, storage images.
+     *
+     * Textures and storage images are the same every frame, so bindings made only of those get a
+     * single descriptor set. A buffer bundle, dynamic uniform or per-set texture makes it one set
+     * per swapchain image. Sets come from DescriptorAllocator::shared() and their layout from
+     * DescriptorLayoutCache::shared().
+     */
+    class ResourceBindings
+    {
+    public:
+        // One slot per swapchain image.
+        ResourceBindings();
+
+        ~ResourceBindings();
+
+        ResourceBindings(const ResourceBindings &) = delete;
+        ResourceBindings &operator=(const ResourceBindings &) = delete;
+
+        void addTexture(const std::shared_ptr<Texture> &texture, VkShaderStageFlags shaderStageFlags);
+
+        // One binding whose texture differs per descriptor set: set i samples textures[i % textures.size()].
+        void addTexture(const std::vector<std::shared_ptr<Texture> > &textures, VkShaderStageFlags shaderStageFlags);
+
+        void addStorageImage(const std::shared_ptr<Image> &image, VkShaderStageFlags shaderStageFlags);
+
+        void addBufferBundle(const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags);
+
+        void addDynamicUniform(const std::shared_ptr<UniformRingBuffer> &ring,
+                               const UniformRingBuffer::Allocation &allocation,
+                               VkShaderStageFlags shaderStageFlags);
+
+        void addStorageBufferBundle(const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags);
+
+        const std::vector<Descriptor<BufferBundle> > &getBufferBundles() const;
+
+        const std::vector<Descriptor<Texture> > &getTextures() const;
+
+        const std::vector<Descriptor<Image> > &getStorageImages() const;
+
+        bool empty() const;
+
+        // Whether one descriptor set serves every swapchain image.
+        bool isFrameInvariant() const;
+
+        std::vector<VkDescriptorSetLayoutBinding> getLayoutBindings() const;
+
+        // Allocates and writes the descriptor sets the first time, does nothing after. Nothing may be added afterwards.
+        void createDescriptorSets();
+
+        bool hasDescriptorSets() const;
+
+        // Writes the resources into new descriptor sets after resources they point at were recreated.
+        // The old sets go back to the allocator through the deletion queue, so frames in flight may still use them.
+        void updateDescriptorSets();
+
+        VkDescriptorSet getDescriptorSet(size_t currentFrame) const;
+
+        // To bind along with the descriptor sets, one per dynamic uniform.
+        const std::vector<uint32_t> &getDynamicOffsets() const;
+
+    private:
+        // Frees the current sets once the frames that may use them are done.
+        void __retireDescriptorSets();
+        void __writeDescriptorSets();
+
+        std::vector<Descriptor<BufferBundle> > m_bufferBundleDescriptors;
+        std::vector<Descriptor<DynamicUniform> > m_dynamicUniformDescriptors;
+        std::vector<uint32_t> m_dynamicOffsets;
+        std::vector<Descriptor<BufferBundle> > m_storageBufferDescriptors;
+        std::vector<Descriptor<Texture> > m_textureDescriptors;
+        // Parallel to m_textureDescriptors. Empty unless the texture differs per descriptor set.
+        std::vector<std::vector<std::shared_ptr<Texture> > > m_perSetTextures;
+        std::vector<Descriptor<Image> > m_storageImageDescriptors;
+
+        uint32_t m_numFrames;
+
+        // Given back to the allocator through the deletion queue.
+        std::shared_ptr<DescriptorAllocator> m_descriptorAllocator;
+        // One, or one per swapchain image.
+        std::vector<VkDescriptorSet> m_descriptorSets;
+    };
+}
@@ -1,8 +1,10 @@
+#include <algorithm>
+#include <unordered_set>
 #include "Scene.h"
 
 namespace mcvkp
 {
-    Scene::Scene(RenderPassType RenderPassType)
+    Scene::Scene(RenderPassType RenderPassType, size_t numAttachmentSets)
     {
         switch (RenderPassType)
         {
@@ -10,16 +12,20 @@ namespace mcvkp
             _initFlatRenderPass();
             break;
         case RenderPassType::eForward:
-            _initForwardRenderPass();
+            _initForwardRenderPass(numAttachmentSets);
             break;
         default:
             break;
         }
     }
 
-    void Scene::_initForwardRenderPass()
+    Scene::Scene(std::shared_ptr<RenderPass> renderPass) : m_RenderPass(renderPass)
     {
-        m_RenderPass = std::make_shared<ForwardRenderPass>();
+    }
+
+    void Scene::_initForwardRenderPass(size_t numAttachmentSets)
+    {
+        m_RenderPass = std::make_shared<ForwardRenderPass>(numAttachmentSets);
     }
 
     void Scene::_initFlatRenderPass()
@@ -29,8 +35,69 @@ namespace mcvkp
 
     void Scene::addModel(std::shared_ptr<DrawableModel> model)
     {
-        model->getMaterial()->init(*m_RenderPass->getBody());
-        m_models.push_back(model);
+        model->getMaterial()->initAsync(*m_RenderPass->getBody());
+        m_pendingModels.push_back(model);
+    }
+
+    void Scene::waitForPipelines()
+    {
+        _resolvePendingModels(true);
+    }
+
+    void Scene::_resolvePendingModels(bool wait)
+    {
+        std::vector<std::shared_ptr<DrawableModel> > stillPending;
+        for (std::shared_ptr<DrawableModel> model : m_pendingModels)
+        {
+            if (!wait && !model->getMaterial()->isPipelineReady())
+            {
+                stillPending.push_back(model);
+                continue;
+            }
+            model->getMaterial()->finishInit();
+
+            // Keep models sharing a pipeline next to each other, so their draws skip rebinding it.
+            std::shared_ptr<PipelineTemplate> pipelineTemplate = model->getMaterial()->getPipelineTemplate();
+            auto last = std::find_if(m_models.rbegin(), m_models.rend(), [&](const std::shared_ptr<DrawableModel> &other)
+                                     { return other->getMaterial()->getPipelineTemplate() == pipelineTemplate; });
+            m_models.insert(last == m_models.rend() ? m_models.end() : last.base(), model);
+        }
+        m_pendingModels.swap(stillPending);
+    }
+
+    void Scene::updateDrawCommands(const glm::mat4 &viewProj, const glm::vec3 &cameraPosition, float projectionScale, const size_t currentFrame)
+    {
+        _resolvePendingModels(false);
+
+        Frustum frustum(viewProj);
+        for (std::shared_ptr<DrawableModel> model : m_models)
+        {
+            model->updateDrawCommands(frustum, cameraPosition, projectionScale, currentFrame);
+        }
+    }
+
+    void Scene::getTriangleCounts(size_t &visible, size_t &total) const
+    {
+        visible = 0;
+        total = 0;
+        for (std::shared_ptr<DrawableModel> model : m_models)
+        {
+            visible += model->getVisibleIndexCount() / 3;
+            total += model->getIndexCount() / 3;
+        }
+    }
+
+    void Scene::updateDescriptorSets()
+    {
+        // Models may share a material, which only needs new sets once.
+        std::unordered_set<Material *> updated;
+        for (std::shared_ptr<DrawableModel> model : m_models)
+        {
+            if (updated.insert(model->getMaterial().get()).second)
+            {
+                model->getMaterial()->updateDescriptorSets();
+            }
+        }
     }
 
     std::shared_ptr<RenderPass> Scene::getRenderPass()
@@ -39,6 +106,20 @@ namespace mcvkp
     }
 
     void Scene::writeRenderCommand(VkCommandBuffer &commandBuffer, const size_t currentFrame)
+    {
+        _beginRenderPass(commandBuffer, currentFrame, VK_SUBPASS_CONTENTS_INLINE);
+        recordDraws(commandBuffer, currentFrame);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    void Scene::writeRenderCommand(VkCommandBuffer &commandBuffer, const size_t currentFrame, ParallelCommandRecorder &recorder)
+    {
+        _beginRenderPass(commandBuffer, currentFrame, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        recordDraws(commandBuffer, currentFrame, recorder);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    void Scene::_beginRenderPass(VkCommandBuffer &commandBuffer, const size_t currentFrame, VkSubpassContents contents)
     {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -53,13 +134,29 @@ namespace mcvkp
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+    }
 
+    void Scene::recordDraws(VkCommandBuffer &commandBuffer, const size_t currentFrame)
+    {
+        DrawableModel::BindState bindState;
         for (std::shared_ptr<DrawableModel> model : m_models)
         {
-            model->drawCommand(commandBuffer, currentFrame);
+            model->drawCommand(commandBuffer, currentFrame, bindState);
         }
+    }
 
-        vkCmdEndRenderPass(commandBuffer);
+    void Scene::recordDraws(VkCommandBuffer &commandBuffer, const size_t currentFrame, ParallelCommandRecorder &recorder)
+    {
+        recorder.recordDraws(commandBuffer, *m_RenderPass->getBody(), *m_RenderPass->getFramebuffer(currentFrame), m_models.size(),
+                             [this, currentFrame](VkCommandBuffer &secondary, size_t begin, size_t end)
+                             {
+                                 // Secondary command buffers start without any bound state.
+                                 DrawableModel::BindState bindState;
+                                 for (size_t i = begin; i < end; i++)
+                                 {
+                                     m_models[i]->drawCommand(secondary, currentFrame, bindState);
+                                 }
+                             });
     }
 }
@@ -5,6 +5,7 @@
 #include "../render-context/RenderPass.h"
 #include "../render-context/ForwardRenderPass.h"
 #include "../render-context/FlatRenderPass.h"
+#include "../render-context/ParallelCommandRecorder.h"
 #include "../utils/vulkan.h"
 
 namespace mcvkp
@@ -19,16 +20,40 @@ namespace mcvkp
     class Scene
     {
     public:
-        Scene(RenderPassType type);
+        // numAttachmentSets only matters for forward passes. See ForwardRenderPass.
+        Scene(RenderPassType type, size_t numAttachmentSets = 1);
+        // Draws into a render pass built elsewhere, e.g. by a RenderGraph.
+        Scene(std::shared_ptr<RenderPass> renderPass);
         void writeRenderCommand(VkCommandBuffer &commandBuffer, const size_t currentFrame);
+        // Splits the models across the recorder's workers, each drawing into a secondary command buffer.
+        void writeRenderCommand(VkCommandBuffer &commandBuffer, const size_t currentFrame, ParallelCommandRecorder &recorder);
+        // Only the draws, for when the caller begins and ends the render pass.
+        void recordDraws(VkCommandBuffer &commandBuffer, const size_t currentFrame);
+        // Same, for a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+        void recordDraws(VkCommandBuffer &commandBuffer, const size_t currentFrame, ParallelCommandRecorder &recorder);
+        // Starts building the model's pipeline on the thread pool. The model is drawn once its
+        // pipeline is ready, checked at every updateDrawCommands, or after waitForPipelines.
         void addModel(std::shared_ptr<DrawableModel> model);
+        // Blocks until every added model's pipeline is built and the models are drawable.
+        void waitForPipelines();
+        // Picks levels of detail and culls meshlets of every model for the given frame. See DrawableModel::updateDrawCommands.
+        void updateDrawCommands(const glm::mat4 &viewProj, const glm::vec3 &cameraPosition, float projectionScale, const size_t currentFrame);
+        // Triangles drawn after the last update, and at full detail without culling.
+        void getTriangleCounts(size_t &visible, size_t &total) const;
+        // See Material::updateDescriptorSets.
+        void updateDescriptorSets();
         std::shared_ptr<RenderPass> getRenderPass();
 
     private:
         std::vector<std::shared_ptr<DrawableModel> > m_models;
+        // Added, but their pipelines are still being built.
+        std::vector<std::shared_ptr<DrawableModel> > m_pendingModels;
         std::shared_ptr<RenderPass> m_RenderPass;
 
         void _initFlatRenderPass();
-        void _initForwardRenderPass();
+        void _initForwardRenderPass(size_t numAttachmentSets);
+        // Moves models whose pipelines are ready (or all of them, waiting) from pending to drawn.
+        void _resolvePendingModels(bool wait);
+        void _beginRenderPass(VkCommandBuffer &commandBuffer, const size_t currentFrame, VkSubpassContents contents);
     };
 }
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include "../utils/ThreadPool.h"
+#include "VertexDedup.h"
+
+namespace mcvkp
+{
+    namespace VertexDedup
+    {
+        namespace
+        {
+            // Below this many corners the threads cost more than they save.
+            const size_t PARALLEL_THRESHOLD = 1 << 16;
+            const size_t HASH_BLOCK_SIZE = 1 << 14;
+            const size_t MAX_SHARDS = 64;
+
+            const uint32_t EMPTY_SLOT = 0xffffffffu;
+
+            // Linear-probing table of 32-bit ids. Each slot keeps the upper half of the hash
+            // so most mismatches are rejected without touching the vertex.
+            class FlatTable
+            {
+            public:
+                FlatTable(size_t maxEntries)
+                {
+                    size_t capacity = 16;
+                    while (capacity < maxEntries + maxEntries / 2 + 1)
+                    {
+                        capacity <<= 1;
+                    }
+                    m_slots.assign(capacity, Slot{EMPTY_SLOT, 0});
+                    m_mask = capacity - 1;
+                }
+
+                // Returns the id of an equal entry, or stores newId and returns it.
+                template <typename Equal>
+                uint32_t findOrInsert(uint64_t hash, uint32_t newId, Equal equal)
+                {
+                    size_t pos = static_cast<size_t>(hash) & m_mask;
+                    uint32_t tag = static_cast<uint32_t>(hash >> 32);
+                    while (true)
+                    {
+                        Slot &slot = m_slots[pos];
+                        if (slot.id == EMPTY_SLOT)
+                        {
+                            slot.id = newId;
+                            slot.tag = tag;
+                            return newId;
+                        }
+                        if (slot.tag == tag && equal(slot.id))
+                        {
+                            return slot.id;
+                        }
+                        pos = (pos + 1) & m_mask;
+                    }
+                }
+
+            private:
+                struct Slot
+                {
+                    uint32_t id;
+                    uint32_t tag;
+                };
+
+                std::vector<Slot> m_slots;
+                size_t m_mask;
+            };
+
+            void deduplicateSequential(const Vertex *corners,
+                                       size_t numCorners,
+                                       std::vector<Vertex> &vertices,
+                                       std::vector<uint32_t> &indices)
+            {
+                FlatTable table(numCorners);
+                for (size_t i = 0; i < numCorners; i++)
+                {
+                    const Vertex &corner = corners[i];
+                    uint32_t next = static_cast<uint32_t>(vertices.size());
+                    uint32_t id = table.findOrInsert(corner.hash(), next, [&](uint32_t other) { return vertices[other] == corner; });
+                    if (id == next)
+                    {
+                        vertices.push_back(corner);
+                    }
+                    indices[i] = id;
+                }
+            }
+
+            void deduplicateParallel(const Vertex *corners,
+                                     size_t numCorners,
+                                     std::vector<Vertex> &vertices,
+                                     std::vector<uint32_t> &indices,
+                                     ThreadPool &pool,
+                                     size_t numShards)
+            {
+                size_t shardBits = 0;
+                while ((size_t(1) << shardBits) < numShards)
+                {
+                    shardBits++;
+                }
+
+                std::vector<uint64_t> hashes(numCorners);
+                size_t numBlocks = (numCorners + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE;
+                pool.parallelFor(numBlocks, [&](size_t block) {
+                    size_t end = std::min(numCorners, (block + 1) * HASH_BLOCK_SIZE);
+                    for (size_t i = block * HASH_BLOCK_SIZE; i < end; i++)
+                    {
+                        hashes[i] = corners[i].hash();
+                    }
+                });
+
+                // Counting sort of the corners by shard, so each shard job walks only its own corners.
+                // Corners stay in increasing order within a shard, which keeps "first" meaning first.
+                std::vector<size_t> shardOffsets(numShards + 1, 0);
+                for (size_t i = 0; i < numCorners; i++)
+                {
+                    shardOffsets[(hashes[i] >> (64 - shardBits)) + 1]++;
+                }
+                for (size_t shard = 0; shard < numShards; shard++)
+                {
+                    shardOffsets[shard + 1] += shardOffsets[shard];
+                }
+                std::vector<uint32_t> shardCorners(numCorners);
+                std::vector<size_t> cursors(shardOffsets.begin(), shardOffsets.end() - 1);
+                for (size_t i = 0; i < numCorners; i++)
+                {
+                    shardCorners[cursors[hashes[i] >> (64 - shardBits)]++] = static_cast<uint32_t>(i);
+                }
+
+                // Each shard records, per corner, the first corner with an equal vertex. Shards never
+                // share a vertex, so no locking.
+                std::vector<uint32_t> firstUse(numCorners);
+                pool.parallelFor(numShards, [&](size_t shard) {
+                    FlatTable table(shardOffsets[shard + 1] - shardOffsets[shard]);
+                    for (size_t j = shardOffsets[shard]; j < shardOffsets[shard + 1]; j++)
+                    {
+                        uint32_t i = shardCorners[j];
+                        firstUse[i] = table.findOrInsert(hashes[i], i, [&](uint32_t other) { return corners[other] == corners[i]; });
+                    }
+                });
+
+                // Number vertices in order of first use, exactly like the sequential path.
+                for (size_t i = 0; i < numCorners; i++)
+                {
+                    if (firstUse[i] == i)
+                    {
+                        indices[i] = static_cast<uint32_t>(vertices.size());
+                        vertices.push_back(corners[i]);
+                    }
+                    else
+                    {
+                        indices[i] = indices[firstUse[i]];
+                    }
+                }
+            }
+        }
+
+        void deduplicate(const Vertex *corners,
+                         size_t numCorners,
+                         std::vector<Vertex> &vertices,
+                         std::vector<uint32_t> &indices,
+                         bool parallel)
+        {
+            vertices.clear();
+            indices.resize(numCorners);
+
+            ThreadPool &pool = ThreadPool::shared();
+            size_t numShards = 1;
+            while (numShards < pool.size() + 1 && numShards < MAX_SHARDS)
+            {
+                numShards <<= 1;
+            }
+
+            if (!parallel || numCorners < PARALLEL_THRESHOLD || numShards == 1)
+            {
+                deduplicateSequential(corners, numCorners, vertices, indices);
+            }
+            else
+            {
+                deduplicateParallel(corners, numCorners, vertices, indices, pool, numShards);
+            }
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Mesh.h"
+
+namespace mcvkp
+{
+    namespace VertexDedup
+    {
+        /**
+         * Collapses identical vertices. Writes the unique vertices in order of first use and one index
+         * per input vertex. Uses a flat open-addressing table sized from the input count, so there is
+         * no allocation per unique vertex.
+         *
+         * With parallel set, large inputs are sharded on the top hash bits and each shard is
+         * deduplicated on its own thread. The output is identical to the sequential path.
+         */
+        void deduplicate(const Vertex *corners,
+                         size_t numCorners,
+                         std::vector<Vertex> &vertices,
+                         std::vector<uint32_t> &indices,
+                         bool parallel);
+    }
+}
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+#include "VertexQuantizer.h"
+
+namespace mcvkp
+{
+    namespace VertexQuantizer
+    {
+        namespace
+        {
+            const float UNORM16_MAX = 65535.0f;
+            const float SNORM16_MAX = 32767.0f;
+
+            float signNotZero(float value)
+            {
+                return value >= 0.0f ? 1.0f : -1.0f;
+            }
+
+            uint16_t toUnorm16(float value)
+            {
+                return static_cast<uint16_t>(std::round(std::clamp(value, 0.0f, 1.0f) * UNORM16_MAX));
+            }
+
+            int16_t toSnorm16(float value)
+            {
+                return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * SNORM16_MAX));
+            }
+        }
+
+        void encodeNormal(const glm::vec3 &normal, int16_t encoded[2])
+        {
+            float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+            if (l1 == 0.0f)
+            {
+                encoded[0] = 0;
+                encoded[1] = 0;
+                return;
+            }
+            float x = normal.x / l1;
+            float y = normal.y / l1;
+            if (normal.z < 0.0f)
+            {
+                // Fold the lower hemisphere over the diagonals.
+                float foldedX = (1.0f - std::abs(y)) * signNotZero(x);
+                float foldedY = (1.0f - std::abs(x)) * signNotZero(y);
+                x = foldedX;
+                y = foldedY;
+            }
+            encoded[0] = toSnorm16(x);
+            encoded[1] = toSnorm16(y);
+        }
+
+        void quantize(const Vertex *vertices,
+                      size_t numVertices,
+                      std::vector<CompactVertex> &compactVertices,
+                      VertexDequantization &dequantization)
+        {
+            glm::vec3 boundsMin(0.0f);
+            glm::vec3 boundsMax(0.0f);
+            if (numVertices > 0)
+            {
+                boundsMin = vertices[0].pos;
+                boundsMax = vertices[0].pos;
+            }
+            for (size_t i = 1; i < numVertices; i++)
+            {
+                boundsMin = glm::min(boundsMin, vertices[i].pos);
+                boundsMax = glm::max(boundsMax, vertices[i].pos);
+            }
+
+            // Flat axes keep a scale of 1 so they do not divide by zero.
+            glm::vec3 extent = boundsMax - boundsMin;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (extent[axis] <= 0.0f)
+                {
+                    extent[axis] = 1.0f;
+                }
+            }
+            dequantization.scale = glm::vec4(extent, 0.0f);
+            dequantization.offset = glm::vec4(boundsMin, 1.0f);
+
+            compactVertices.resize(numVertices);
+            for (size_t i = 0; i < numVertices; i++)
+            {
+                const Vertex &vertex = vertices[i];
+                CompactVertex &compact = compactVertices[i];
+
+                glm::vec3 normalized = (vertex.pos - boundsMin) / extent;
+                compact.pos[0] = toUnorm16(normalized.x);
+                compact.pos[1] = toUnorm16(normalized.y);
+                compact.pos[2] = toUnorm16(normalized.z);
+                compact.pos[3] = 0;
+
+                encodeNormal(vertex.normal, compact.normal);
+
+                compact.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+                compact.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+            }
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Mesh.h"
+
+namespace mcvkp
+{
+    namespace VertexQuantizer
+    {
+        /**
+         * Converts vertices to CompactVertex. Positions are normalized to the bounding box of the
+         * mesh, which is returned as the dequantization transform the vertex shader applies.
+         */
+        void quantize(const Vertex *vertices,
+                      size_t numVertices,
+                      std::vector<CompactVertex> &compactVertices,
+                      VertexDequantization &dequantization);
+
+        // Octahedral encoding of a unit vector into two snorm16 values.
+        void encodeNormal(const glm::vec3 &normal, int16_t encoded[2]);
+    }
+}
@@ -4,6 +4,14 @@
 #include <unordered_map>
 #include <array>
 #include <string>
+#include <cstring>
+#include <iostream>
+#include "../utils/Hash.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "ObjParser.h"
+#include "VertexDedup.h"
 #include "Mesh.h"
 
 VkVertexInputBindingDescription Vertex::getBindingDescription()
@@ -38,11 +46,62 @@ std::array<VkVertexInputAttributeDescription, 3> Vertex::getAttributeDescription
     return attributeDescriptions;
 }
 
+VkVertexInputBindingDescription CompactVertex::getBindingDescription()
+{
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(CompactVertex);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 3> CompactVertex::getAttributeDescriptions()
+{
+    static_assert(sizeof(CompactVertex) == 16, "CompactVertex is expected to be 16 bytes");
+    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset = offsetof(CompactVertex, pos);
+
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[1].offset = offsetof(CompactVertex, normal);
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(CompactVertex, texCoord);
+
+    return attributeDescriptions;
+}
+
 bool Vertex::operator==(const Vertex &other) const
 {
     return pos == other.pos && normal == other.normal && texCoord == other.texCoord;
 }
 
+uint64_t Vertex::hash() const
+{
+    static_assert(sizeof(Vertex) == 8 * sizeof(uint32_t), "Vertex is expected to be 8 tightly packed floats");
+    uint32_t bits[8];
+    memcpy(bits, this, sizeof(bits));
+    for (uint32_t &b : bits)
+    {
+        // -0.0 == 0.0, so both must hash the same.
+        if (b == 0x80000000u)
+        {
+            b = 0;
+        }
+    }
+    uint64_t words[4];
+    memcpy(words, bits, sizeof(words));
+    return mcvkp::Hash::words(words, 4);
+}
+
 Mesh::Mesh(MeshType type)
 {
     switch (type)
@@ -92,46 +151,110 @@ void Mesh::initPlane()
     indices = {0, 3, 2, 2, 1, 0};
 }
 
-Mesh::Mesh(std::string model_path)
+namespace
 {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+    void loadWithTinyObj(const std::string &modelPath, mcvkp::ObjData &data)
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model_path.c_str()))
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, modelPath.c_str()))
+        {
+            throw std::runtime_error(warn + err);
+        }
+
+        data.positions = std::move(attrib.vertices);
+        data.normals = std::move(attrib.normals);
+        data.texcoords = std::move(attrib.texcoords);
+        for (const auto &shape : shapes)
+        {
+            for (const auto &index : shape.mesh.indices)
+            {
+                data.indices.push_back({index.vertex_index, index.normal_index, index.texcoord_index});
+            }
+        }
+    }
+
+    template <typename T>
+    bool sameBits(const std::vector<T> &a, const std::vector<T> &b)
     {
-        throw std::runtime_error(warn + err);
+        return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
     }
 
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+    void verifyAgainstTinyObj(const std::string &modelPath, const mcvkp::ObjData &data)
+    {
+        mcvkp::ObjData reference;
+        loadWithTinyObj(modelPath, reference);
+        bool matches = sameBits(data.positions, reference.positions) &&
+                       sameBits(data.normals, reference.normals) &&
+                       sameBits(data.texcoords, reference.texcoords) &&
+                       sameBits(data.indices, reference.indices);
+        std::cout << "OBJ parser " << (matches ? "matches" : "DIFFERS FROM") << " tinyobj for " << modelPath << "\n";
+    }
+}
 
-    for (const auto &shape : shapes)
+Mesh::Mesh(std::string model_path, const MeshImportOptions &options)
+{
+    mcvkp::ObjData obj;
+    if (mcvkp::ObjParser::parse(model_path, obj))
     {
-        for (const auto &index : shape.mesh.indices)
+        if (options.verifyObjParser)
         {
-            Vertex vertex{};
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]};
-
-            vertex.normal = {
-                attrib.normals[3 * index.normal_index + 0],
-                attrib.normals[3 * index.normal_index + 1],
-                attrib.normals[3 * index.normal_index + 2]};
-
-            vertex.texCoord = {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
-
-            if (uniqueVertices.count(vertex) == 0)
-            {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                vertices.push_back(vertex);
-            }
+            verifyAgainstTinyObj(model_path, obj);
+        }
+    }
+    else
+    {
+        loadWithTinyObj(model_path, obj);
+    }
+
+    // Expand every face corner into a full vertex, then collapse the duplicates.
+    std::vector<Vertex> corners(obj.indices.size());
+    for (size_t i = 0; i < obj.indices.size(); i++)
+    {
+        const mcvkp::ObjIndex &index = obj.indices[i];
+        Vertex &vertex = corners[i];
+        vertex.pos = {
+            obj.positions[3 * index.vertex + 0],
+            obj.positions[3 * index.vertex + 1],
+            obj.positions[3 * index.vertex + 2]};
+
+        vertex.normal = {
+            obj.normals[3 * index.normal + 0],
+            obj.normals[3 * index.normal + 1],
+            obj.normals[3 * index.normal + 2]};
+
+        vertex.texCoord = {
+            obj.texcoords[2 * index.texcoord + 0],
+            1.0f - obj.texcoords[2 * index.texcoord + 1]};
+    }
+
+    mcvkp::VertexDedup::deduplicate(corners.data(), corners.size(), vertices, indices, options.parallelDedup);
+
+    if (options.optimize)
+    {
+        mcvkp::MeshOptimizer::CacheStats before, after;
+        mcvkp::MeshOptimizer::optimize(*this, before, after);
+        std::cout << "Optimized " << model_path << ": ACMR " << before.acmr << " -> " << after.acmr
+                  << ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+    }
+
+    if (options.buildMeshlets)
+    {
+        mcvkp::MeshletBuilder::build(*this);
+    }
 
-            indices.push_back(uniqueVertices[vertex]);
+    if (options.buildLods)
+    {
+        mcvkp::MeshSimplifier::buildLods(*this, options.optimize);
+        std::cout << "Built " << lods.size() << " levels of detail for " << model_path << ":";
+        for (const MeshLod &lod : lods)
+        {
+            std::cout << " " << lod.indexCount / 3;
         }
+        std::cout << " triangles"
+                  << "\n";
     }
-}
+}
\ No newline at end of file
@@ -14,11 +14,12 @@ struct SharedUniformBufferObject
     glm::vec4 lightPos;
 };
 
-struct UniformBufferObject
+// One entry of the object storage buffer, indexed by the objectId push constant.
+struct ObjectData
 {
-    UniformBufferObject() {}
-    UniformBufferObject(const glm::mat4 &model) : model(model) {}
     glm::mat4 model;
+    // Inverse transpose of the model matrix's upper 3x3, so shaders don't invert per vertex.
+    glm::mat4 normalMatrix;
 };
 
 enum class MeshType
@@ -27,6 +28,33 @@ enum class MeshType
     eCube
 };
 
+enum class VertexFormat
+{
+    // Vertex: full precision floats, 32 bytes.
+    eFull,
+    // CompactVertex: quantized, 16 bytes. Needs the "-compact" shader variants.
+    eCompact
+};
+
+// Controls how a model file is turned into a Mesh.
+struct MeshImportOptions
+{
+    // Reuse the binary mesh cache next to the model file. Set to false to always parse the OBJ.
+    bool useCache = true;
+    // Also parse with tinyobj and report whether the multithreaded parser produced identical data.
+    bool verifyObjParser = false;
+    // Deduplicate vertices of large meshes on the shared thread pool. The result is the same either way.
+    bool parallelDedup = true;
+    // Reorder triangles for vertex cache reuse and overdraw, then vertices for fetch locality.
+    bool optimize = false;
+    // Layout of the uploaded vertex buffer. Must match the vertex format of the model's material.
+    VertexFormat vertexFormat = VertexFormat::eFull;
+    // Partition the index buffer into meshlets that are culled on the CPU every frame.
+    bool buildMeshlets = false;
+    // Append simplified levels of detail to the index buffer.
+    bool buildLods = false;
+};
+
 struct Vertex
 {
     glm::vec3 pos;
@@ -37,6 +65,62 @@ struct Vertex
     static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
 
     bool operator==(const Vertex &other) const;
+
+    // Hash of all 32 bytes. Consistent with operator==, so -0.0 and 0.0 hash the same.
+    uint64_t hash() const;
+};
+
+/**
+ * Quantized vertex. The position is stored as 16-bit unorm inside the mesh bounds, the normal as
+ * octahedral snorm16x2 and the texture coordinates as half floats. The 4th position component is
+ * padding, since 3-component 16-bit formats are rarely supported for vertex input.
+ */
+struct CompactVertex
+{
+    uint16_t pos[4];
+    int16_t normal[2];
+    uint16_t texCoord[2];
+
+    static VkVertexInputBindingDescription getBindingDescription();
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
+};
+
+// Per-mesh push constant that maps CompactVertex positions back to model space: pos * scale + offset.
+struct VertexDequantization
+{
+    glm::vec4 scale;
+    glm::vec4 offset;
+};
+
+// Vertex stage push constants of every material. Full format shaders only declare objectId.
+struct DrawPushConstants
+{
+    uint32_t objectId;
+    uint32_t padding[3];
+    VertexDequantization dequantization;
+};
+
+/**
+ * A contiguous range of the index buffer, small enough to be culled on its own. The bounds are in
+ * model space. The cone contains the normals of all triangles: the meshlet is backfacing for a
+ * camera at p if dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius.
+ */
+struct Meshlet
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// One level of detail: a range of the index buffer and its simplification error in model units.
+struct MeshLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
 };
 
 namespace std
@@ -46,10 +130,7 @@ namespace std
     {
         size_t operator()(Vertex const &vertex) const
         {
-            return ((hash<glm::vec3>()(vertex.pos) ^
-                     (hash<glm::vec3>()(vertex.normal) << 1)) >>
-                    1) ^
-                   (hash<glm::vec2>()(vertex.texCoord) << 1);
+            return static_cast<size_t>(vertex.hash());
         }
     };
 }
@@ -58,10 +139,14 @@ struct Mesh
 {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    // Meshlets cover the full detail level only.
+    std::vector<Meshlet> meshlets;
+    // Empty, or every level starting with full detail at index 0.
+    std::vector<MeshLod> lods;
 
     Mesh() = default;
 
-    Mesh(std::string model_path);
+    Mesh(std::string model_path, const MeshImportOptions &options = MeshImportOptions());
 
     Mesh(MeshType type);
 
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include "glm.h"
+
+namespace mcvkp
+{
+    // View frustum planes, extracted from a view-projection matrix with a [0, 1] depth range.
+    class Frustum
+    {
+    public:
+        Frustum(const glm::mat4 &viewProj)
+        {
+            glm::mat4 m = glm::transpose(viewProj);
+            m_planes[0] = m[3] + m[0]; // left
+            m_planes[1] = m[3] - m[0]; // right
+            m_planes[2] = m[3] + m[1]; // bottom
+            m_planes[3] = m[3] - m[1]; // top
+            m_planes[4] = m[2];        // near
+            m_planes[5] = m[3] - m[2]; // far
+            for (glm::vec4 &plane : m_planes)
+            {
+                plane /= glm::length(glm::vec3(plane));
+            }
+        }
+
+        // Conservative: spheres near a frustum corner may pass without being visible.
+        bool intersectsSphere(const glm::vec3 &center, float radius) const
+        {
+            for (const glm::vec4 &plane : m_planes)
+            {
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        std::array<glm::vec4, 6> m_planes;
+    };
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace mcvkp
+{
+    namespace Hash
+    {
+        const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+        const uint64_t FNV_PRIME = 1099511628211ull;
+
+        // 64-bit FNV-1a. Used for cache keys, not for hash tables.
+        inline uint64_t fnv1a(const void *data, size_t size, uint64_t seed = FNV_OFFSET_BASIS)
+        {
+            const unsigned char *bytes = static_cast<const unsigned char *>(data);
+            uint64_t hash = seed;
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= bytes[i];
+                hash *= FNV_PRIME;
+            }
+            return hash;
+        }
+
+        inline uint64_t fnv1a(const std::string &str, uint64_t seed = FNV_OFFSET_BASIS)
+        {
+            return fnv1a(str.data(), str.size(), seed);
+        }
+
+        // MurmurHash3 finalizer: every input bit affects every output bit.
+        inline uint64_t mix64(uint64_t x)
+        {
+            x ^= x >> 33;
+            x *= 0xff51afd7ed558ccdull;
+            x ^= x >> 33;
+            x *= 0xc4ceb9fe1a85ec53ull;
+            x ^= x >> 33;
+            return x;
+        }
+
+        // Hash of a few 64-bit words, for hash tables keyed on small fixed-size structs.
+        inline uint64_t words(const uint64_t *data, size_t count)
+        {
+            const uint64_t PRIME1 = 0x9e3779b185ebca87ull;
+            const uint64_t PRIME2 = 0xc2b2ae3d27d4eb4full;
+            uint64_t hash = PRIME1 ^ (count * PRIME2);
+            for (size_t i = 0; i < count; i++)
+            {
+                hash ^= mix64(data[i] * PRIME2);
+                hash = ((hash << 27) | (hash >> 37)) * PRIME1 + PRIME2;
+            }
+            return mix64(hash);
+        }
+    }
+}
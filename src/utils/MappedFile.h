@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace mcvkp
+{
+    // Read-only memory mapping of a whole file. Owns the mapping and releases it on destruction.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        MappedFile(const std::string &path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+
+        bool isOpen() const { return m_opened; }
+        const char *data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+        void close();
+
+    private:
+        const char *m_data = nullptr;
+        size_t m_size = 0;
+        // Empty files open successfully but have nothing to map.
+        bool m_opened = false;
+#ifdef _WIN32
+        void *m_file = nullptr;
+        void *m_mapping = nullptr;
+#endif
+    };
+}
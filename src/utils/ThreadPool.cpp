@@ -0,0 +1,134 @@
+#include <atomic>
+#include <algorithm>
+#include <exception>
+#include "ThreadPool.h"
+
+namespace mcvkp
+{
+    ThreadPool::ThreadPool(size_t numThreads)
+    {
+        if (numThreads == 0)
+        {
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < numThreads; i++)
+        {
+            m_workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_condition.notify_all();
+        for (auto &worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool &ThreadPool::shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    void ThreadPool::enqueue(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push(std::move(job));
+        }
+        m_condition.notify_one();
+    }
+
+    void ThreadPool::workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+                if (m_stopping && m_jobs.empty())
+                {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop();
+            }
+            job();
+        }
+    }
+
+    void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &fn)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        if (count == 1)
+        {
+            fn(0);
+            return;
+        }
+
+        // Helpers may start after the caller is done with all items, so the shared state
+        // outlives this call and helpers never touch fn once every item has been claimed.
+        struct State
+        {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            size_t count;
+            const std::function<void(size_t)> *fn;
+            std::mutex mutex;
+            std::condition_variable finished;
+            // The first exception thrown by fn, rethrown on the calling thread.
+            std::exception_ptr error;
+        };
+        auto state = std::make_shared<State>();
+        state->count = count;
+        state->fn = &fn;
+
+        auto run = [](State &s) {
+            size_t i;
+            while ((i = s.next.fetch_add(1)) < s.count)
+            {
+                try
+                {
+                    (*s.fn)(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(s.mutex);
+                    if (!s.error)
+                    {
+                        s.error = std::current_exception();
+                    }
+                }
+                if (s.done.fetch_add(1) + 1 == s.count)
+                {
+                    std::lock_guard<std::mutex> lock(s.mutex);
+                    s.finished.notify_all();
+                }
+            }
+        };
+
+        size_t helpers = std::min(count - 1, m_workers.size());
+        for (size_t i = 0; i < helpers; i++)
+        {
+            enqueue([state, run]() { run(*state); });
+        }
+        run(*state);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&]() { return state->done.load() == count; });
+        if (state->error)
+        {
+            std::rethrow_exception(state->error);
+        }
+    }
+}
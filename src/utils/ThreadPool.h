@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace mcvkp
+{
+    // Fixed set of worker threads pulling jobs from a shared queue.
+    class ThreadPool
+    {
+    public:
+        // Zero means one worker per hardware thread.
+        ThreadPool(size_t numThreads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        size_t size() const { return m_workers.size(); }
+
+        template <typename F>
+        auto submit(F &&job) -> std::future<typename std::invoke_result<F>::type>
+        {
+            using Result = typename std::invoke_result<F>::type;
+            auto task = std::make_shared<std::packaged_task<Result()> >(std::forward<F>(job));
+            std::future<Result> future = task->get_future();
+            enqueue([task]() { (*task)(); });
+            return future;
+        }
+
+        // Calls fn(i) for every i in [0, count) on the workers and the calling thread.
+        // Returns once all calls have finished. Safe to call from inside a job. If any call throws,
+        // the rest still run and the first exception is rethrown here on the calling thread.
+        void parallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+        // Process-wide pool shared by loaders and renderers.
+        static ThreadPool &shared();
+
+    private:
+        void enqueue(std::function<void()> job);
+        void workerLoop();
+
+        std::vector<std::thread> m_workers;
+        std::queue<std::function<void()> > m_jobs;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_stopping = false;
+    };
+}